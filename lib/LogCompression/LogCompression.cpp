@@ -0,0 +1,74 @@
+#include "LogCompression.h"
+
+int lzCompress(const uint8_t* input, size_t inputLength, uint8_t* output, size_t capacity) {
+  if (inputLength > LZ_MAX_INPUT_LEN || capacity < LZ_HEADER_LEN) return -1;
+  output[0] = (uint8_t)inputLength;
+  output[1] = (uint8_t)(inputLength >> 8);
+  size_t out = LZ_HEADER_LEN;
+  size_t flagsAt = 0;
+  int items = 8;
+  size_t in = 0;
+  while (in < inputLength) {
+    if (items == 8) {
+      if (out >= capacity) return -1;
+      flagsAt = out;
+      output[out++] = 0;
+      items = 0;
+    }
+    size_t maxLength = inputLength - in < LZ_MAX_MATCH ? inputLength - in : LZ_MAX_MATCH;
+    size_t maxDistance = in < LZ_WINDOW_SIZE ? in : LZ_WINDOW_SIZE;
+    size_t bestLength = 0;
+    size_t bestDistance = 0;
+    for (size_t distance = 1; distance <= maxDistance && bestLength < maxLength; distance++) {
+      // a match may run into the bytes it is itself producing, the decoder copies byte by byte
+      size_t length = 0;
+      while (length < maxLength && input[in - distance + length] == input[in + length]) length++;
+      if (length > bestLength) {
+        bestLength = length;
+        bestDistance = distance;
+      }
+    }
+    if (bestLength >= LZ_MIN_MATCH) {
+      if (out + 2 > capacity) return -1;
+      uint16_t token = (uint16_t)(((bestDistance - 1) << 6) | (bestLength - LZ_MIN_MATCH));
+      output[out++] = (uint8_t)token;
+      output[out++] = (uint8_t)(token >> 8);
+      in += bestLength;
+    } else {
+      if (out + 1 > capacity) return -1;
+      output[flagsAt] |= 1 << items;
+      output[out++] = input[in++];
+    }
+    items++;
+  }
+  return (int)out;
+}
+
+int lzDecompress(const uint8_t* input, size_t inputLength, uint8_t* output, size_t capacity) {
+  if (inputLength < LZ_HEADER_LEN) return -1;
+  size_t expectedLength = input[0] | (input[1] << 8);
+  if (expectedLength > capacity) return -1;
+  size_t in = LZ_HEADER_LEN;
+  size_t out = 0;
+  while (out < expectedLength) {
+    if (in >= inputLength) return -1;
+    uint8_t flags = input[in++];
+    for (int item = 0; item < 8 && out < expectedLength; item++) {
+      if (flags & (1 << item)) {
+        if (in >= inputLength) return -1;
+        output[out++] = input[in++];
+        continue;
+      }
+      if (in + 2 > inputLength) return -1;
+      uint16_t token = input[in] | (input[in + 1] << 8);
+      in += 2;
+      size_t distance = (token >> 6) + 1;
+      size_t length = (token & 0x3F) + LZ_MIN_MATCH;
+      if (distance > out || out + length > expectedLength) return -1;
+      for (size_t i = 0; i < length; i++, out++) {
+        output[out] = output[out - distance];
+      }
+    }
+  }
+  return in == inputLength ? (int)expectedLength : -1;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// LZSS for the FIELD_LOG_RECORDS of a LOG_CHUNK. Tokenized records repeat their
+// format tokens, close timestamps and argument bytes, so a chunk read from flash
+// shrinks well below its size and one frame carries more of the log. Works on whole
+// buffers, the history window is the input itself.
+//
+// Stream layout:
+//   [0..1] uncompressed length, u16 little-endian
+//   groups of one flag byte followed by up to 8 items, flag bit i set = item i is a literal byte,
+//   clear = a match of 2 bytes: distance - 1 (10 bits) and length - LZ_MIN_MATCH (6 bits), little-endian
+
+#define LZ_WINDOW_SIZE    1024
+#define LZ_MIN_MATCH      3
+#define LZ_MAX_MATCH      (LZ_MIN_MATCH + 63)
+#define LZ_HEADER_LEN     2
+#define LZ_MAX_INPUT_LEN  65535
+
+// Compressed length, -1 when the stream does not fit in capacity.
+int lzCompress(const uint8_t* input, size_t inputLength, uint8_t* output, size_t capacity);
+// Uncompressed length, -1 when the stream is corrupt or does not fit in capacity.
+int lzDecompress(const uint8_t* input, size_t inputLength, uint8_t* output, size_t capacity);
@@ -0,0 +1,73 @@
+#include "LogRing.h"
+#include <string.h>
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of 2");
+
+static uint32_t recordSpan(size_t length) {
+  return LOG_RING_HEADER_LEN + (((uint32_t)length + 3) & ~3u);
+}
+
+LogRing::LogRing() : reserved(0), tail(0), dropped(0), highWater(0) {
+  memset(buffer, 0, sizeof(buffer));
+}
+
+void LogRing::copyIn(uint32_t position, const uint8_t* data, size_t length) {
+  uint32_t offset = position & (LOG_RING_SIZE - 1);
+  size_t first = LOG_RING_SIZE - offset < length ? LOG_RING_SIZE - offset : length;
+  memcpy(&buffer[offset], data, first);
+  memcpy(buffer, data + first, length - first);
+}
+
+void LogRing::copyOut(uint32_t position, uint8_t* data, size_t length) {
+  uint32_t offset = position & (LOG_RING_SIZE - 1);
+  size_t first = LOG_RING_SIZE - offset < length ? LOG_RING_SIZE - offset : length;
+  memcpy(data, &buffer[offset], first);
+  memcpy(data + first, buffer, length - first);
+}
+
+void LogRing::clear(uint32_t position, size_t length) {
+  uint32_t offset = position & (LOG_RING_SIZE - 1);
+  size_t first = LOG_RING_SIZE - offset < length ? LOG_RING_SIZE - offset : length;
+  memset(&buffer[offset], 0, first);
+  memset(buffer, 0, length - first);
+}
+
+bool LogRing::push(const uint8_t* record, size_t length) {
+  if (length == 0 || length > LOG_RING_MAX_RECORD) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  uint32_t span = recordSpan(length);
+  uint32_t position = reserved.load(std::memory_order_relaxed);
+  uint32_t used;
+  do {
+    used = position + span - tail.load(std::memory_order_acquire);
+    if (used > LOG_RING_SIZE) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  } while (!reserved.compare_exchange_weak(position, position + span, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+  uint32_t peak = highWater.load(std::memory_order_relaxed);
+  while (used > peak && !highWater.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {}
+
+  copyIn(position + LOG_RING_HEADER_LEN, record, length);
+  //the header goes last, the consumer reads nothing of a record before it sees it
+  __atomic_store_n(header(position), LOG_RING_PUBLISHED | (uint32_t)length, __ATOMIC_RELEASE);
+  return true;
+}
+
+size_t LogRing::pop(uint8_t* data, size_t capacity) {
+  uint32_t position = tail.load(std::memory_order_relaxed);
+  if (position == reserved.load(std::memory_order_acquire)) return 0;
+  uint32_t value = __atomic_load_n(header(position), __ATOMIC_ACQUIRE);
+  if ((value & LOG_RING_PUBLISHED) == 0) return 0; //claimed, still being written
+  size_t length = value & ~LOG_RING_PUBLISHED;
+  if (length > capacity) return 0;
+  copyOut(position + LOG_RING_HEADER_LEN, data, length);
+  //a later header may land anywhere in this span, it must not look published
+  uint32_t span = recordSpan(length);
+  clear(position, span);
+  tail.store(position + span, std::memory_order_release);
+  return length;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Lock-free ring of variable length records, written by any number of tasks and
+// read by a single one. A producer claims space with a compare-and-swap on the
+// reserve position, copies its record and then publishes the record's header; the
+// consumer takes records in claim order and stops at the first unpublished one.
+// Producers never wait: when the ring is full the record is dropped and counted.
+//
+// Record layout: [header u32: LOG_RING_PUBLISHED | length][payload, padded to 4 bytes]
+
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE           4096 //bytes, power of 2
+#endif
+#define LOG_RING_HEADER_LEN     4
+#define LOG_RING_MAX_RECORD     (LOG_RING_SIZE / 4)
+#define LOG_RING_PUBLISHED      0x80000000u
+
+class LogRing {
+  public:
+    LogRing();
+    bool push(const uint8_t* record, size_t length); //false when the record was dropped
+    size_t pop(uint8_t* buffer, size_t capacity); //next record, 0 when there is none or it does not fit
+    bool isEmpty() const { return tail.load(std::memory_order_acquire) == reserved.load(std::memory_order_acquire); };
+    uint32_t getUsed() const { return reserved.load(std::memory_order_relaxed) - tail.load(std::memory_order_relaxed); };
+    uint32_t getDropped() const { return dropped.load(std::memory_order_relaxed); };
+    uint32_t getHighWater() const { return highWater.load(std::memory_order_relaxed); }; //most bytes in use at once
+  private:
+    alignas(4) uint8_t buffer[LOG_RING_SIZE];
+    std::atomic<uint32_t> reserved; //free running byte positions, masked on access
+    std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> dropped;
+    std::atomic<uint32_t> highWater;
+    void copyIn(uint32_t position, const uint8_t* data, size_t length);
+    void copyOut(uint32_t position, uint8_t* data, size_t length);
+    void clear(uint32_t position, size_t length);
+    uint32_t* header(uint32_t position) { return (uint32_t*)&buffer[position & (LOG_RING_SIZE - 1)]; };
+};
@@ -0,0 +1,259 @@
+#include "LogTokens.h"
+#include <stdio.h>
+#include <string.h>
+
+#define FNV_OFFSET_BASIS  2166136261u
+#define FNV_PRIME         16777619u
+#define SPEC_MAX_LEN      24
+
+struct ConversionSpec {
+  char flags[6];
+  bool widthArg;        //width given as *
+  bool precisionArg;
+  char width[8];
+  char precision[8];    //without the dot, empty when absent
+  bool hasPrecision;
+  bool wide;            //ll or j, 8 byte integer
+  char length;          //h, l, z, t, L, j or 0
+  char conversion;
+};
+
+// p points after the %, returns the position after the conversion character
+static const char* parseSpec(const char* p, ConversionSpec& spec) {
+  memset(&spec, 0, sizeof(spec));
+  size_t n = 0;
+  while (*p && strchr("-+ #0", *p) && n < sizeof(spec.flags) - 1) spec.flags[n++] = *p++;
+  n = 0;
+  if (*p == '*') {
+    spec.widthArg = true;
+    p++;
+  }
+  while (*p >= '0' && *p <= '9' && n < sizeof(spec.width) - 1) spec.width[n++] = *p++;
+  if (*p == '.') {
+    spec.hasPrecision = true;
+    p++;
+    n = 0;
+    if (*p == '*') {
+      spec.precisionArg = true;
+      p++;
+    }
+    while (*p >= '0' && *p <= '9' && n < sizeof(spec.precision) - 1) spec.precision[n++] = *p++;
+  }
+  while (*p && strchr("hlLjzt", *p)) {
+    if (*p == 'j' || (*p == 'l' && spec.length == 'l')) spec.wide = true;
+    spec.length = *p++;
+  }
+  spec.conversion = *p;
+  return *p ? p + 1 : p;
+}
+
+static bool isIntegerConversion(char c) {
+  return c != 0 && strchr("diouxXc", c) != NULL;
+}
+
+static bool isFloatConversion(char c) {
+  return c != 0 && strchr("fFeEgGaA", c) != NULL;
+}
+
+uint32_t logTokenHash(const char* format) {
+  uint32_t hash = FNV_OFFSET_BASIS;
+  for (const uint8_t* p = (const uint8_t*)format; *p; p++) {
+    hash ^= *p;
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+static void writeU32(uint8_t* p, uint32_t value) {
+  p[0] = value;
+  p[1] = value >> 8;
+  p[2] = value >> 16;
+  p[3] = value >> 24;
+}
+
+static uint32_t readU32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+size_t logTokenEncode(uint8_t* record, uint32_t time, const char* format, va_list args) {
+  writeU32(record, logTokenHash(format));
+  writeU32(&record[4], time);
+  uint8_t* out = &record[LOG_TOKEN_HEADER_LEN];
+  size_t used = 0;
+  bool full = false;
+  for (const char* p = format; *p && !full; ) {
+    if (*p++ != '%') continue;
+    if (*p == '%') {
+      p++;
+      continue;
+    }
+    ConversionSpec spec;
+    p = parseSpec(p, spec);
+    //values are taken off the va_list even when they no longer fit, the next ones would be misread
+    uint8_t value[8];
+    size_t length = 4;
+    const char* text = NULL;
+    if (spec.widthArg) {
+      writeU32(value, va_arg(args, int));
+      if (used + 4 > LOG_TOKEN_MAX_ARGS_LEN) break;
+      memcpy(&out[used], value, 4);
+      used += 4;
+    }
+    if (spec.precisionArg) {
+      writeU32(value, va_arg(args, int));
+      if (used + 4 > LOG_TOKEN_MAX_ARGS_LEN) break;
+      memcpy(&out[used], value, 4);
+      used += 4;
+    }
+    if (isIntegerConversion(spec.conversion)) {
+      uint64_t number;
+      if (spec.wide) number = va_arg(args, unsigned long long);
+      else if (spec.length == 'l') number = va_arg(args, unsigned long);
+      else if (spec.length == 'z' || spec.length == 't') number = va_arg(args, size_t);
+      else number = va_arg(args, unsigned int);
+      writeU32(value, (uint32_t)number);
+      if (spec.wide) {
+        writeU32(&value[4], (uint32_t)(number >> 32));
+        length = 8;
+      }
+    } else if (isFloatConversion(spec.conversion)) {
+      float number = spec.length == 'L' ? (float)va_arg(args, long double) : (float)va_arg(args, double);
+      memcpy(value, &number, 4);
+    } else if (spec.conversion == 'p') {
+      writeU32(value, (uint32_t)(uintptr_t)va_arg(args, void*));
+    } else if (spec.conversion == 's') {
+      text = va_arg(args, const char*);
+      if (text == NULL) text = "(null)";
+      length = strlen(text);
+      if (length > LOG_TOKEN_MAX_STRING) length = LOG_TOKEN_MAX_STRING;
+    } else {
+      break; //%n or unknown, the rest of the format can't be followed
+    }
+    if (text != NULL) {
+      full = used + 1 + length > LOG_TOKEN_MAX_ARGS_LEN;
+      if (full) break;
+      out[used++] = (uint8_t)length;
+      memcpy(&out[used], text, length);
+    } else {
+      full = used + length > LOG_TOKEN_MAX_ARGS_LEN;
+      if (full) break;
+      memcpy(&out[used], value, length);
+    }
+    used += length;
+  }
+  record[8] = (uint8_t)used;
+  return LOG_TOKEN_HEADER_LEN + used;
+}
+
+size_t logTokenParse(const uint8_t* data, size_t length, LogTokenRecord& record) {
+  if (length < LOG_TOKEN_HEADER_LEN || length < LOG_TOKEN_HEADER_LEN + (size_t)data[8]) return 0;
+  record.token = readU32(data);
+  record.time = readU32(&data[4]);
+  record.argsLength = data[8];
+  record.args = &data[LOG_TOKEN_HEADER_LEN];
+  return LOG_TOKEN_HEADER_LEN + record.argsLength;
+}
+
+// Appends to out, always keeping it terminated
+static void append(char* out, size_t capacity, size_t& used, const char* text, size_t length) {
+  if (used + 1 >= capacity) return;
+  if (length > capacity - 1 - used) length = capacity - 1 - used;
+  memcpy(&out[used], text, length);
+  used += length;
+  out[used] = '\0';
+}
+
+size_t logTokenRender(const char* format, const LogTokenRecord& record, char* out, size_t capacity) {
+  size_t used = 0;
+  size_t offset = 0;
+  if (capacity == 0) return 0;
+  out[0] = '\0';
+  const char* p = format;
+  while (*p) {
+    const char* literal = p;
+    while (*p && *p != '%') p++;
+    append(out, capacity, used, literal, p - literal);
+    if (*p == '\0') break;
+    p++;
+    if (*p == '%') {
+      append(out, capacity, used, "%", 1);
+      p++;
+      continue;
+    }
+    ConversionSpec spec;
+    p = parseSpec(p, spec);
+    char text[LOG_TOKEN_MAX_STRING + 64];
+    int width = 0;
+    int precision = 0;
+    bool missing = false;
+    if (spec.widthArg) {
+      missing = offset + 4 > record.argsLength;
+      if (!missing) width = (int32_t)readU32(&record.args[offset]);
+      offset += 4;
+    }
+    if (spec.precisionArg) {
+      missing = missing || offset + 4 > record.argsLength;
+      if (!missing) precision = (int32_t)readU32(&record.args[offset]);
+      offset += 4;
+    }
+    //the conversion again, widths resolved and the length modifier matching the stored size
+    char conversion[SPEC_MAX_LEN];
+    int n = snprintf(conversion, sizeof(conversion), "%%%s", spec.flags);
+    if (spec.widthArg) n += snprintf(&conversion[n], sizeof(conversion) - n, "%d", width);
+    else n += snprintf(&conversion[n], sizeof(conversion) - n, "%s", spec.width);
+    if (spec.precisionArg) n += snprintf(&conversion[n], sizeof(conversion) - n, ".%d", precision);
+    else if (spec.hasPrecision) n += snprintf(&conversion[n], sizeof(conversion) - n, ".%s", spec.precision);
+
+    int length = -1;
+    if (isIntegerConversion(spec.conversion)) {
+      size_t size = spec.wide ? 8 : 4;
+      if (!missing && offset + size <= record.argsLength) {
+        uint64_t number = readU32(&record.args[offset]);
+        if (spec.wide) {
+          number |= (uint64_t)readU32(&record.args[offset + 4]) << 32;
+          snprintf(&conversion[n], sizeof(conversion) - n, "ll%c", spec.conversion);
+          length = snprintf(text, sizeof(text), conversion, (long long)number);
+        } else {
+          snprintf(&conversion[n], sizeof(conversion) - n, "%c", spec.conversion);
+          length = snprintf(text, sizeof(text), conversion, (int32_t)number);
+        }
+      }
+      offset += size;
+    } else if (isFloatConversion(spec.conversion)) {
+      if (!missing && offset + 4 <= record.argsLength) {
+        float number;
+        memcpy(&number, &record.args[offset], 4);
+        snprintf(&conversion[n], sizeof(conversion) - n, "%c", spec.conversion);
+        length = snprintf(text, sizeof(text), conversion, (double)number);
+      }
+      offset += 4;
+    } else if (spec.conversion == 'p') {
+      if (!missing && offset + 4 <= record.argsLength) {
+        length = snprintf(text, sizeof(text), "0x%08x", (unsigned)readU32(&record.args[offset]));
+      }
+      offset += 4;
+    } else if (spec.conversion == 's') {
+      //a length the encoder never writes comes from a damaged or forged record, nothing after it can be trusted
+      if (!missing && offset < record.argsLength && record.args[offset] <= LOG_TOKEN_MAX_STRING
+          && offset + 1 + record.args[offset] <= record.argsLength) {
+        char value[LOG_TOKEN_MAX_STRING + 1];
+        size_t size = record.args[offset];
+        memcpy(value, &record.args[offset + 1], size);
+        value[size] = '\0';
+        snprintf(&conversion[n], sizeof(conversion) - n, "s");
+        length = snprintf(text, sizeof(text), conversion, value);
+        offset += 1 + size;
+      } else {
+        offset = record.argsLength;
+      }
+    } else {
+      break; //the encoder stopped here as well
+    }
+    if (length < 0) {
+      append(out, capacity, used, "?", 1);
+    } else {
+      append(out, capacity, used, text, (size_t)length < sizeof(text) ? length : sizeof(text) - 1);
+    }
+  }
+  return used;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+// Tokenized log records: the format string is replaced by its FNV-1a hash and the
+// arguments are stored raw, so logging on the device copies a few bytes instead of
+// formatting text. Rendering happens on a host that has the firmware ELF, where
+// every format string can be found and hashed again (tools/log_decode).
+//
+// Record layout (little-endian):
+//   [0..3] token        logTokenHash() of the format string
+//   [4..7] time         seconds, time(NULL) when logged
+//   [8]    args length
+//   [9..]  one value per conversion of the format, in order:
+//          integers, chars, * widths  4 bytes, 8 with ll or j
+//          floating point             float, 4 bytes
+//          pointers                   4 bytes
+//          strings                    length u8 then the bytes, cut at LOG_TOKEN_MAX_STRING
+// Sizes follow the ESP32, where long, size_t and pointers are 32 bits.
+
+#define LOG_TOKEN_HEADER_LEN      9
+#define LOG_TOKEN_MAX_ARGS_LEN    200
+#define LOG_TOKEN_MAX_RECORD_LEN  (LOG_TOKEN_HEADER_LEN + LOG_TOKEN_MAX_ARGS_LEN)
+#define LOG_TOKEN_MAX_STRING      64
+
+typedef struct {
+  uint32_t token;
+  uint32_t time;
+  const uint8_t* args;
+  uint8_t argsLength;
+} LogTokenRecord;
+
+uint32_t logTokenHash(const char* format);
+// Consumes args. Arguments that do not fit LOG_TOKEN_MAX_ARGS_LEN are left out, the
+// renderer prints them as "?". Returns the record length.
+size_t logTokenEncode(uint8_t* record, uint32_t time, const char* format, va_list args);
+// Record at the start of data, returns its length or 0 when data is too short.
+size_t logTokenParse(const uint8_t* data, size_t length, LogTokenRecord& record);
+// Text of a record given its format string, cut to fit out. Returns the text length.
+size_t logTokenRender(const char* format, const LogTokenRecord& record, char* out, size_t capacity);
@@ -0,0 +1,225 @@
+#include "TxPipeline.h"
+#include <string.h>
+
+TxPipeline::TxPipeline(const TxPlatform& platform) : completionHead(0), completionTail(0) {
+  this->platform = platform;
+  this->config.window = 2;
+  this->config.maxRetries = 3;
+  this->config.baseBackoffMs = 10;
+  this->config.maxBackoffMs = 80;
+  this->config.sendTimeoutMs = 100;
+  this->inFlightCount = 0;
+  this->owedConfirmations = 0;
+  this->lastTimeoutMs = 0;
+  this->nextSequence = 0;
+  this->batchFailures = 0;
+  for (int i = 0; i < TX_PIPELINE_SLOTS; i++) {
+    slots[i].state = TX_SLOT_FREE;
+  }
+  resetCounters();
+}
+
+void TxPipeline::configure(const TxConfig& config) {
+  this->config = config;
+  if (this->config.window == 0) this->config.window = 1;
+  if (this->config.window > TX_PIPELINE_SLOTS) this->config.window = TX_PIPELINE_SLOTS;
+}
+
+void TxPipeline::resetCounters() {
+  memset(&counters, 0, sizeof(counters));
+}
+
+int TxPipeline::slotIndex(const uint8_t* frame) const {
+  for (int i = 0; i < TX_PIPELINE_SLOTS; i++) {
+    if (slots[i].frame == frame) return i;
+  }
+  return -1;
+}
+
+uint8_t* TxPipeline::acquire() {
+  for (int i = 0; i < TX_PIPELINE_SLOTS; i++) {
+    if (slots[i].state == TX_SLOT_FREE) {
+      slots[i].state = TX_SLOT_RESERVED;
+      return slots[i].frame;
+    }
+  }
+  return NULL;
+}
+
+uint8_t* TxPipeline::acquire(uint32_t timeoutMs) {
+  uint32_t start = now();
+  while (true) {
+    uint8_t* slot = acquire();
+    if (slot != NULL) return slot;
+    poll();
+    if (now() - start >= timeoutMs) {
+      counters.rejected++;
+      batchFailures++;
+      return NULL;
+    }
+    platform.sleepMs(1, platform.context);
+  }
+}
+
+bool TxPipeline::submit(uint8_t* frame, size_t length) {
+  int index = slotIndex(frame);
+  if (index < 0 || slots[index].state != TX_SLOT_RESERVED) return false;
+  Slot& slot = slots[index];
+  if (length > TX_PIPELINE_FRAME_LEN) {
+    counters.rejected++;
+    batchFailures++;
+    release(slot);
+    return false;
+  }
+  slot.length = (uint16_t)length;
+  slot.attempts = 0;
+  slot.sequence = nextSequence++;
+  slot.readyAtMs = now();
+  slot.state = TX_SLOT_QUEUED;
+  counters.queued++;
+  poll();
+  return true;
+}
+
+bool TxPipeline::enqueue(const uint8_t* frame, size_t length) {
+  if (length > TX_PIPELINE_FRAME_LEN) {
+    counters.rejected++;
+    batchFailures++;
+    return false;
+  }
+  uint8_t* slot = acquire();
+  if (slot == NULL) {
+    counters.rejected++;
+    batchFailures++;
+    return false;
+  }
+  memcpy(slot, frame, length);
+  return submit(slot, length);
+}
+
+void TxPipeline::onSendComplete(bool success) {
+  uint8_t head = completionHead.load(std::memory_order_relaxed);
+  uint8_t next = (head + 1) & (TX_PIPELINE_COMPLETIONS - 1);
+  if (next == completionTail.load(std::memory_order_acquire)) return; //full, the send timeout will account for it
+  completions[head] = success;
+  completionHead.store(next, std::memory_order_release);
+}
+
+void TxPipeline::release(Slot& slot) {
+  slot.state = TX_SLOT_FREE;
+}
+
+void TxPipeline::retryOrFail(Slot& slot) {
+  if (slot.attempts > config.maxRetries) {
+    counters.failed++;
+    batchFailures++;
+    release(slot);
+    return;
+  }
+  uint32_t backoff = (uint32_t)config.baseBackoffMs << (slot.attempts - 1);
+  if (backoff > config.maxBackoffMs) backoff = config.maxBackoffMs;
+  counters.retries++;
+  slot.readyAtMs = now() + backoff;
+  slot.state = TX_SLOT_QUEUED;
+}
+
+void TxPipeline::confirm(bool success) {
+  if (owedConfirmations > 0) {
+    // belongs to a frame that timed out and was already counted as failed
+    owedConfirmations--;
+    counters.late++;
+    return;
+  }
+  complete(success);
+}
+
+void TxPipeline::complete(bool success) {
+  if (inFlightCount == 0) return; //confirmation without a frame in flight
+  Slot& slot = slots[inFlightOrder[0]];
+  inFlightCount--;
+  memmove(&inFlightOrder[0], &inFlightOrder[1], inFlightCount * sizeof(inFlightOrder[0]));
+  if (success) {
+    counters.delivered++;
+    release(slot);
+  } else {
+    retryOrFail(slot);
+  }
+}
+
+int TxPipeline::nextQueued(uint32_t nowMs) {
+  int found = -1;
+  for (int i = 0; i < TX_PIPELINE_SLOTS; i++) {
+    const Slot& slot = slots[i];
+    if (slot.state != TX_SLOT_QUEUED || (int32_t)(nowMs - slot.readyAtMs) < 0) continue;
+    if (found < 0 || (int32_t)(slot.sequence - slots[found].sequence) < 0) {
+      found = i;
+    }
+  }
+  return found;
+}
+
+void TxPipeline::transmit(int index, uint32_t nowMs) {
+  Slot& slot = slots[index];
+  slot.attempts++;
+  slot.sentAtMs = nowMs;
+  slot.state = TX_SLOT_IN_FLIGHT;
+  inFlightOrder[inFlightCount++] = index;
+  counters.attempts++;
+  if (platform.send(slot.frame, slot.length, platform.context) != 0) {
+    // rejected by the radio, no confirmation will come for it
+    inFlightCount--;
+    retryOrFail(slot);
+  }
+}
+
+void TxPipeline::poll() {
+  while (completionTail.load(std::memory_order_relaxed) != completionHead.load(std::memory_order_acquire)) {
+    uint8_t tail = completionTail.load(std::memory_order_relaxed);
+    bool success = completions[tail];
+    completionTail.store((tail + 1) & (TX_PIPELINE_COMPLETIONS - 1), std::memory_order_release);
+    confirm(success);
+  }
+
+  uint32_t nowMs = now();
+  while (inFlightCount > 0 && nowMs - slots[inFlightOrder[0]].sentAtMs >= config.sendTimeoutMs) {
+    counters.timeouts++;
+    if (owedConfirmations < UINT8_MAX) owedConfirmations++;
+    lastTimeoutMs = nowMs;
+    complete(false);
+  }
+  if (owedConfirmations > 0 && inFlightCount == 0 && nowMs - lastTimeoutMs >= config.sendTimeoutMs) {
+    owedConfirmations = 0; //lost for good, stop waiting so later confirmations are not dropped
+  }
+
+  while (inFlightCount < config.window) {
+    int index = nextQueued(nowMs);
+    if (index < 0) break;
+    transmit(index, nowMs);
+  }
+}
+
+bool TxPipeline::isIdle() const {
+  for (int i = 0; i < TX_PIPELINE_SLOTS; i++) {
+    if (slots[i].state == TX_SLOT_QUEUED || slots[i].state == TX_SLOT_IN_FLIGHT) return false;
+  }
+  return true;
+}
+
+bool TxPipeline::flush(uint32_t deadlineMs) {
+  uint32_t start = now();
+  bool idle;
+  while (true) {
+    poll();
+    idle = isIdle();
+    if (idle) break;
+    if (now() - start >= deadlineMs) {
+      counters.deadlineExpired = true;
+      break;
+    }
+    platform.sleepMs(1, platform.context);
+  }
+  counters.flushMs += now() - start;
+  bool delivered = idle && batchFailures == 0;
+  batchFailures = 0;
+  return delivered;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Transmit pipeline that waits for the MAC-level send confirmation of every frame.
+// Frames live in a fixed set of slots until they are confirmed or give up after
+// maxRetries, at most `window` frames are in flight at once and failed frames are
+// retried with exponential backoff. Platform access goes through TxPlatform so the
+// pipeline can run on a Linux host against a simulated radio.
+
+#ifndef TX_PIPELINE_SLOTS
+#define TX_PIPELINE_SLOTS           8
+#endif
+#define TX_PIPELINE_FRAME_LEN       250
+#define TX_PIPELINE_COMPLETIONS     16 //must be a power of 2
+
+struct TxPlatform {
+  int (*send)(const uint8_t* frame, size_t length, void* context); //0 when the frame was accepted by the radio
+  uint32_t (*nowMs)(void* context);
+  void (*sleepMs)(uint32_t ms, void* context);
+  void* context;
+};
+
+struct TxConfig {
+  uint8_t window;         //frames in flight at once
+  uint8_t maxRetries;     //retries after the first attempt
+  uint16_t baseBackoffMs; //first retry delay, doubled on every retry
+  uint16_t maxBackoffMs;
+  uint16_t sendTimeoutMs; //in flight frame without confirmation is counted as failed
+};
+
+struct TxCounters {
+  uint16_t queued;
+  uint16_t attempts;
+  uint16_t delivered;
+  uint16_t retries;
+  uint16_t failed;    //gave up after maxRetries
+  uint16_t rejected;  //no free slot or frame too big, fails the next flush like a failed frame
+  uint16_t timeouts;
+  uint16_t late;      //confirmations of frames that had already timed out, ignored
+  uint32_t flushMs;
+  bool deadlineExpired;
+};
+
+enum TxSlotState : uint8_t {
+  TX_SLOT_FREE,
+  TX_SLOT_RESERVED,
+  TX_SLOT_QUEUED,
+  TX_SLOT_IN_FLIGHT
+};
+
+class TxPipeline {
+  public:
+    TxPipeline(const TxPlatform& platform);
+    void configure(const TxConfig& config);
+    uint8_t* acquire(); //free slot to write a frame into, NULL if all are busy
+    uint8_t* acquire(uint32_t timeoutMs); //polls until a slot is released or the timeout expires
+    bool submit(uint8_t* slot, size_t length);
+    bool enqueue(const uint8_t* frame, size_t length);
+    void onSendComplete(bool success); //safe to call from the radio callback
+    void poll();
+    bool flush(uint32_t deadlineMs); //true when every frame since the last flush was confirmed before the deadline
+    bool isIdle() const;
+    int getInFlightCount() const { return inFlightCount; };
+    const TxCounters& getCounters() const { return counters; };
+    void resetCounters();
+  private:
+    struct Slot {
+      uint8_t frame[TX_PIPELINE_FRAME_LEN];
+      uint16_t length;
+      TxSlotState state;
+      uint8_t attempts;
+      uint32_t sequence;   //submission order
+      uint32_t readyAtMs;  //earliest time for the next attempt
+      uint32_t sentAtMs;
+    };
+    TxPlatform platform;
+    TxConfig config;
+    Slot slots[TX_PIPELINE_SLOTS];
+    int inFlightOrder[TX_PIPELINE_SLOTS]; //in flight slots, oldest first
+    int inFlightCount;
+    // Confirmations arrive in send order, so the ones still owed to timed out frames
+    // come before those of every frame in flight and are dropped.
+    uint8_t owedConfirmations;
+    uint32_t lastTimeoutMs;
+    uint32_t nextSequence;
+    TxCounters counters;
+    uint16_t batchFailures; //frames failed, rejected or dropped since the last flush
+    std::atomic<uint8_t> completionHead;
+    std::atomic<uint8_t> completionTail;
+    bool completions[TX_PIPELINE_COMPLETIONS];
+    uint32_t now() { return platform.nowMs(platform.context); };
+    void confirm(bool success);
+    void complete(bool success);
+    void retryOrFail(Slot& slot);
+    void release(Slot& slot);
+    int nextQueued(uint32_t nowMs);
+    void transmit(int index, uint32_t nowMs);
+    int slotIndex(const uint8_t* frame) const;
+};
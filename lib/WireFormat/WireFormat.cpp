@@ -0,0 +1,100 @@
+#include "WireFormat.h"
+#include <string.h>
+
+uint8_t WireField::asU8() const {
+  return length >= 1 ? value[0] : 0;
+}
+
+uint16_t WireField::asU16() const {
+  if (length < 2) return asU8();
+  return wireReadU16(value);
+}
+
+uint32_t WireField::asU32() const {
+  if (length < 4) return asU16();
+  return wireReadU32(value);
+}
+
+FrameEncoder::FrameEncoder(uint8_t* buffer, size_t capacity) {
+  this->buffer = buffer;
+  this->capacity = capacity > WIRE_MAX_FRAME_LEN ? WIRE_MAX_FRAME_LEN : capacity;
+  this->used = 0;
+}
+
+void FrameEncoder::begin(msgType type, uint8_t flags) {
+  buffer[0] = WIRE_MAGIC;
+  buffer[1] = WIRE_VERSION;
+  buffer[2] = type;
+  buffer[3] = flags;
+  used = WIRE_HEADER_LEN;
+}
+
+void FrameEncoder::resume(size_t length) {
+  used = length > capacity ? capacity : length;
+}
+
+size_t FrameEncoder::fieldCapacity() const {
+  if (used + WIRE_FIELD_HEADER_LEN >= capacity) return 0;
+  size_t available = capacity - used - WIRE_FIELD_HEADER_LEN;
+  return available > WIRE_MAX_FIELD_LEN ? WIRE_MAX_FIELD_LEN : available;
+}
+
+bool FrameEncoder::putBytes(uint8_t tag, const void* data, size_t length) {
+  if (used < WIRE_HEADER_LEN) return false; //begin() not called
+  if (length > fieldCapacity()) return false;
+  buffer[used++] = tag;
+  buffer[used++] = (uint8_t)length;
+  memcpy(&buffer[used], data, length);
+  used += length;
+  return true;
+}
+
+bool FrameEncoder::putU8(uint8_t tag, uint8_t value) {
+  return putBytes(tag, &value, 1);
+}
+
+bool FrameEncoder::putU16(uint8_t tag, uint16_t value) {
+  uint8_t bytes[2];
+  wireWriteU16(bytes, value);
+  return putBytes(tag, bytes, sizeof(bytes));
+}
+
+bool FrameEncoder::putU32(uint8_t tag, uint32_t value) {
+  uint8_t bytes[4];
+  wireWriteU32(bytes, value);
+  return putBytes(tag, bytes, sizeof(bytes));
+}
+
+FrameDecoder::FrameDecoder(const uint8_t* frame, size_t length) {
+  this->frame = frame;
+  this->length = length;
+  this->offset = WIRE_HEADER_LEN;
+  this->malformed = false;
+  this->valid = length >= WIRE_HEADER_LEN && length <= WIRE_MAX_FRAME_LEN
+    && frame[0] == WIRE_MAGIC && frame[1] >= 1 && frame[1] <= WIRE_VERSION;
+}
+
+void FrameDecoder::rewind() {
+  if (!valid) return;
+  offset = WIRE_HEADER_LEN;
+  malformed = false;
+}
+
+bool FrameDecoder::nextField(WireField& field) {
+  if (!valid || malformed) return false;
+  if (offset == length) return false; //end of frame
+  if (offset + WIRE_FIELD_HEADER_LEN > length) {
+    malformed = true;
+    return false;
+  }
+  uint8_t fieldLength = frame[offset + 1];
+  if (offset + WIRE_FIELD_HEADER_LEN + fieldLength > length) {
+    malformed = true;
+    return false;
+  }
+  field.tag = frame[offset];
+  field.length = fieldLength;
+  field.value = &frame[offset + WIRE_FIELD_HEADER_LEN];
+  offset += WIRE_FIELD_HEADER_LEN + fieldLength;
+  return true;
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary frame format shared by the sensor firmware and the gateway tools.
+// Plain C++ only, so it builds both for the ESP32 and on a Linux host.
+//
+// Frame layout (little-endian):
+//   [0] magic    WIRE_MAGIC
+//   [1] version  WIRE_VERSION
+//   [2] type     msgType
+//   [3] flags    WIRE_FLAG_*
+//   [4..] fields, each one [tag u8][length u8][value...]
+//
+// Only the bytes actually used are transmitted. Decoders skip fields with
+// unknown tags, so new fields can be added without bumping the version.
+//
+// Every message fits one frame. The log, the only data bigger than that, goes
+// out as LOG_CHUNK frames that each stand on their own (see src/LogExporter.h).
+
+#define WIRE_MAGIC              0xA5
+#define WIRE_VERSION            1
+#define WIRE_MAX_FRAME_LEN      250 //same as ESP_NOW_MAX_DATA_LEN
+#define WIRE_HEADER_LEN         4
+#define WIRE_FIELD_HEADER_LEN   2
+#define WIRE_MAX_FIELD_LEN      255
+
+#define WIRE_FLAG_COMPRESSED    0x02 //LOG_CHUNK whose FIELD_LOG_RECORDS is an LZSS stream, see lib/LogCompression
+#define WIRE_FLAG_REPLY         0x04 //DISCOVERY sent by a gateway in answer, without it the frame is a request
+
+#define WIRE_PHASE_STATS_BUCKETS  6
+#define WIRE_PHASE_STATS_LEN      (15 + WIRE_PHASE_STATS_BUCKETS)
+#define WIRE_SAMPLE_RECORD_LEN    10
+#define WIRE_AGE_UNKNOWN          0xFFFFFFFF //sample taken before the sensor last lost power
+#define WIRE_FILL_LEVEL_LEN       3
+#define WIRE_TANK_STATS_LEN       9
+#define WIRE_FILL_FLAG_FAULT      0x01 //probe pattern impossible, percent is the lowest level the probes vouch for
+#define WIRE_FILL_UNKNOWN         0xFF //sensor has no probe ladder
+#define WIRE_LOG_RANGE_LEN        8
+#define WIRE_LOG_INFLATED_MAX_LEN 1024 //records a compressed FIELD_LOG_RECORDS holds at most
+#define WIRE_FRAME_SEQUENCE_LEN   (WIRE_FIELD_HEADER_LEN + 2) //room a full frame leaves for FIELD_FRAME_SEQUENCE
+
+// 2, 3 and 6 were the types of fragmented messages, left unused
+enum msgType : uint8_t {
+  SENSOR_INFO = 1,
+  TELEMETRY = 4,
+  DISCOVERY = 5,  //broadcast by a sensor looking for gateways, answered with WIRE_FLAG_REPLY by every gateway that hears it
+  LOG_CHUNK = 7,  //slice of the log on flash, FIELD_LOG_RANGE and FIELD_LOG_RECORDS, one frame each
+  LOG_REQUEST = 8 //sent by a gateway, asks the sensor for the FIELD_LOG_RANGE part of its log
+};
+
+enum fieldTag : uint8_t {
+  FIELD_TEXT = 1,             //raw bytes
+  FIELD_WATER_LEVEL = 2,      //u8, 0 = OK, 1 = LOW
+  FIELD_BATTERY_VOLTAGE = 3,  //u16, millivolts
+  FIELD_BATTERY_CHARGE = 4,   //u8, percent
+  FIELD_PHASE_STATS = 5,      //phase u8, count u16, min/avg/max u32 microseconds, histogram u8[WIRE_PHASE_STATS_BUCKETS]
+  FIELD_SAMPLE_BATCH = 6,     //oldest first, records of age u32 seconds before the frame or WIRE_AGE_UNKNOWN, water level u8, millivolts u16, charge u8,
+                              //fill percent u8, fill flags u8
+  FIELD_FILL_LEVEL = 7,       //percent u8 or WIRE_FILL_UNKNOWN, wet probe mask u8 (bit 0 = lowest probe), flags u8 WIRE_FILL_FLAG_*
+  FIELD_TANK_STATS = 8,       //smoothed level u8 percent, smoothed rate i16 0.1 percent/hour, seconds since the level moved u32,
+                              //anomaly score u8 tenths, active alerts u8 TANK_ALERT_*
+  FIELD_LOG_RANGE = 9,        //log addresses u32 from, u32 to (exclusive). A chunk holds every record still stored in the range,
+                              //a request with to = 0 asks for everything up to the newest record
+  FIELD_LOG_RECORDS = 10,     //whole tokenized records, see lib/LogTokens
+  FIELD_FRAME_SEQUENCE = 11   //u16 counting the single frames of a sender, repeated by a retransmission so the gateway can drop it
+};
+
+inline uint16_t wireReadU16(const uint8_t* bytes) {
+  return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+inline uint32_t wireReadU32(const uint8_t* bytes) {
+  return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+inline void wireWriteU16(uint8_t* bytes, uint16_t value) {
+  bytes[0] = (uint8_t)value;
+  bytes[1] = (uint8_t)(value >> 8);
+}
+
+inline void wireWriteU32(uint8_t* bytes, uint32_t value) {
+  bytes[0] = (uint8_t)value;
+  bytes[1] = (uint8_t)(value >> 8);
+  bytes[2] = (uint8_t)(value >> 16);
+  bytes[3] = (uint8_t)(value >> 24);
+}
+
+struct WireField {
+  uint8_t tag;
+  uint8_t length;
+  const uint8_t* value;
+  uint8_t asU8() const;
+  uint16_t asU16() const;
+  uint32_t asU32() const;
+};
+
+class FrameEncoder {
+  public:
+    FrameEncoder(uint8_t* buffer, size_t capacity);
+    void begin(msgType type, uint8_t flags = 0);
+    void resume(size_t length); //adds fields to a frame already in the buffer, e.g. a copy of another encoder
+    bool putU8(uint8_t tag, uint8_t value);
+    bool putU16(uint8_t tag, uint16_t value);
+    bool putU32(uint8_t tag, uint32_t value);
+    bool putBytes(uint8_t tag, const void* data, size_t length);
+    size_t fieldCapacity() const; //largest value that still fits in one field
+    size_t length() const { return used; };
+    const uint8_t* data() const { return buffer; };
+    bool hasFields() const { return used > WIRE_HEADER_LEN; };
+  private:
+    uint8_t* buffer;
+    size_t capacity;
+    size_t used;
+};
+
+class FrameDecoder {
+  public:
+    FrameDecoder(const uint8_t* frame, size_t length);
+    bool isValid() const { return valid; };
+    bool isMalformed() const { return malformed; };
+    uint8_t version() const { return frame[1]; };
+    msgType type() const { return (msgType)frame[2]; };
+    uint8_t flags() const { return frame[3]; };
+    bool nextField(WireField& field);
+    void rewind();
+  private:
+    const uint8_t* frame;
+    size_t length;
+    size_t offset;
+    bool valid;
+    bool malformed;
+};
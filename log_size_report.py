@@ -0,0 +1,52 @@
+# Post build report of the flash taken by logging. Prints the image size of the firmware
+# and the log format strings in it, then the difference to the other environments already
+# built, e.g. ttgo-lora32-v1-production (LOG_DISABLED) against ttgo-lora32-v1.
+Import("env")
+import os
+import re
+import struct
+
+SHF_ALLOC = 0x2
+SHF_EXECINSTR = 0x4
+SHT_NOBITS = 8
+LOG_FORMAT = re.compile(rb"^(\x1b\[[0-9;]*m)?[EWIDV] \(%") # ESP_LOG formats, colored or not
+
+def elf_sizes(path):
+    """image bytes, log format strings and their bytes of a 32-bit ELF file"""
+    with open(path, "rb") as file:
+        image = file.read()
+    if image[:4] != b"\x7fELF" or image[4] != 1:
+        return None
+    shoff, = struct.unpack_from("<I", image, 0x20)
+    shentsize, shnum = struct.unpack_from("<HH", image, 0x2E)
+    total = strings = string_bytes = 0
+    for i in range(shnum):
+        _, kind, flags, _, offset, size = struct.unpack_from("<IIIIII", image, shoff + i * shentsize)
+        if not flags & SHF_ALLOC or kind == SHT_NOBITS:
+            continue
+        total += size
+        if flags & SHF_EXECINSTR:
+            continue
+        for text in image[offset:offset + size].split(b"\0"):
+            if LOG_FORMAT.match(text):
+                strings += 1
+                string_bytes += len(text) + 1
+    return total, strings, string_bytes
+
+def report(source, target, env):
+    name = env.subst("$PIOENV")
+    sizes = elf_sizes(target[0].get_abspath())
+    if sizes is None:
+        return
+    print("%s: %d image bytes, %d log format strings taking %d bytes" % (name, sizes[0], sizes[1], sizes[2]))
+    builds = os.path.dirname(env.subst("$BUILD_DIR"))
+    for other in sorted(os.listdir(builds)):
+        path = os.path.join(builds, other, "firmware.elf")
+        if other == name or not os.path.isfile(path):
+            continue
+        other_sizes = elf_sizes(path)
+        if other_sizes is not None:
+            print("  %+d image bytes, %+d log string bytes against %s" % (
+                sizes[0] - other_sizes[0], sizes[2] - other_sizes[2], other))
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", report)
@@ -17,14 +17,14 @@ AppConfig::AppConfig(Config *config) {
 }
 
 AppConfig::~AppConfig() {
-  ESP_LOGI("APPCONFIG", "AppConfig destructor called");
+  ESP_LOGI(APPCONFIG, "AppConfig destructor called");
 }
 
 void AppConfig::listFiles() {
   File root = LittleFS.open("/");
   File file_ = root.openNextFile();
   while(file_){
-    ESP_LOGI("APPCONFIG", "FILE: %s", file_.name());
+    ESP_LOGI(APPCONFIG, "FILE: %s", file_.name());
 
     file_ = root.openNextFile();
   }
@@ -32,25 +32,25 @@ void AppConfig::listFiles() {
 
 bool AppConfig::loadJsonConfig()
 {
-  ESP_LOGI("APPCONFIG", "Loading JSON config");
+  ESP_LOGI(APPCONFIG, "Loading JSON config");
 
   if(!LittleFS.begin(true)){
-    ESP_LOGE("APPCONFIG", "An Error has occurred while mounting LittleFS");
+    ESP_LOGE(APPCONFIG, "An Error has occurred while mounting LittleFS");
     return false;
   }
 
   //listFiles();
 
-  ESP_LOGI("APPCONFIG", "Reading file: %s", filePath);
+  ESP_LOGI(APPCONFIG, "Reading file: %s", filePath);
   File file = LittleFS.open(filePath, FILE_READ);
   if(!file){
-    ESP_LOGI("APPCONFIG", "There was an error opening the file");
+    ESP_LOGI(APPCONFIG, "There was an error opening the file");
     return false;
   }
 
   auto err = deserializeJson(json_doc, file);
   if(err) {
-    ESP_LOGE("APPCONFIG", "Unable to deserialize JSON to JsonDocument: %s", err.c_str() );
+    ESP_LOGE(APPCONFIG, "Unable to deserialize JSON to JsonDocument: %s", err.c_str() );
     return false;
   }
 
@@ -65,6 +65,18 @@ bool AppConfig::loadJsonConfig()
   strlcpy(config->mqttUser, json_doc["mqtt"]["user"], sizeof(config->mqttUser));
   strlcpy(config->mqttPassword, json_doc["mqtt"]["password"], sizeof(config->mqttPassword));
   strlcpy(config->espNowGatewayMacAddress, json_doc["espnow"]["gatewayMacAddress"], sizeof(config->espNowGatewayMacAddress));
+
+  config->espNowGatewayCount = 0;
+  if (strlen(config->espNowGatewayMacAddress) > 0) {
+    strlcpy(config->espNowGatewayMacAddresses[config->espNowGatewayCount++], config->espNowGatewayMacAddress, 18);
+  }
+  JsonArray gateways = json_doc["espnow"]["gatewayMacAddresses"];
+  for (JsonVariant gateway : gateways) {
+    const char* macAddress = gateway.as<const char*>();
+    if (macAddress == NULL || config->espNowGatewayCount == CONFIG_MAX_GATEWAYS) continue;
+    strlcpy(config->espNowGatewayMacAddresses[config->espNowGatewayCount++], macAddress, 18);
+  }
+  ESP_LOGI(APPCONFIG, "%d ESP-NOW gateways configured", config->espNowGatewayCount);
   
   return true;
 }
@@ -1,6 +1,7 @@
 #include <ArduinoJson.h>
 
 #define DEFAULT_CONFIG_FILE_PATH "/config.json"
+#define CONFIG_MAX_GATEWAYS 4
 
 struct Config {
   char wifiSSID[64];
@@ -11,6 +12,8 @@ struct Config {
   char mqttUser[64];
   char mqttPassword[64];
   char espNowGatewayMacAddress[18];
+  char espNowGatewayMacAddresses[CONFIG_MAX_GATEWAYS][18]; //espNowGatewayMacAddress first, then the gatewayMacAddresses list
+  int espNowGatewayCount;
 };
 
 class AppConfig {
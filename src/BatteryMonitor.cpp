@@ -0,0 +1,32 @@
+#include "BatteryMonitor.h"
+#include "BatteryTable.h"
+#include "ESPLogMacros.h"
+
+BatteryMonitor::BatteryMonitor(uint8_t adcPin, uint8_t enablePin) {
+  this->adcPin = adcPin;
+  this->enablePin = enablePin;
+}
+
+void BatteryMonitor::begin() {
+  pinMode(enablePin, OUTPUT);
+  digitalWrite(enablePin, LOW);
+  //attenuation stays at the core default of 12 dB, up to about 3.1 V at the pin: enough for a halved Li-ion cell
+  analogReadResolution(12);
+}
+
+BatteryReading BatteryMonitor::measure() {
+  digitalWrite(enablePin, HIGH);
+  delayMicroseconds(BATTERY_SETTLE_US);
+  uint32_t sum = 0;
+  for (int i = 0; i < BATTERY_SAMPLES; i++) {
+    sum += analogReadMilliVolts(adcPin);
+  }
+  digitalWrite(enablePin, LOW);
+
+  uint32_t pinMillivolts = (sum + BATTERY_SAMPLES / 2) / BATTERY_SAMPLES;
+  ESP_LOGD(BATTERY, "ADC pin at %u mV", (unsigned)pinMillivolts);
+  BatteryReading reading;
+  reading.millivolts = (uint16_t)(pinMillivolts * BATTERY_DIVIDER_RATIO);
+  reading.charge = batteryChargeFromMillivolts(reading.millivolts);
+  return reading;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+
+#define BATTERY_SAMPLES             16  //ADC reads averaged into one measurement
+#define BATTERY_DIVIDER_RATIO       2   //battery voltage is halved before the ADC pin
+#define BATTERY_SETTLE_US           500 //divider settling time after ADC_EN goes high
+
+typedef struct {
+  uint16_t millivolts;
+  uint8_t charge;     //percent, from BATTERY_TABLE
+} BatteryReading;
+
+// Measures the battery through the divider switched by enablePin. The divider is only
+// powered while sampling, and one averaged reading gives both voltage and charge.
+// The core corrects every ADC read with the calibration burnt in eFuse by the factory.
+class BatteryMonitor {
+    public:
+        BatteryMonitor(uint8_t adcPin, uint8_t enablePin);
+        void begin();
+        BatteryReading measure();
+    private:
+        uint8_t adcPin;
+        uint8_t enablePin;
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+
+// Resting voltage to state of charge of a single LiPo / Li-ion cell at light load.
+// Charge is interpolated linearly between points; everything is constexpr so the
+// table is checked at compile time and lives in flash.
+
+struct BatteryTablePoint {
+  uint16_t millivolts;
+  uint8_t charge;     //percent
+};
+
+constexpr BatteryTablePoint BATTERY_TABLE[] = {
+  {3270, 0}, {3610, 5}, {3690, 10}, {3710, 15}, {3730, 20}, {3750, 25}, {3770, 30},
+  {3790, 35}, {3800, 40}, {3820, 45}, {3840, 50}, {3850, 55}, {3870, 60}, {3910, 65},
+  {3950, 70}, {3980, 75}, {4020, 80}, {4080, 85}, {4110, 90}, {4150, 95}, {4200, 100}
+};
+
+constexpr int BATTERY_TABLE_SIZE = sizeof(BATTERY_TABLE) / sizeof(BATTERY_TABLE[0]);
+
+constexpr bool batteryTableIsSorted(int i = 1) {
+  return i >= BATTERY_TABLE_SIZE || (BATTERY_TABLE[i].millivolts > BATTERY_TABLE[i - 1].millivolts
+    && BATTERY_TABLE[i].charge >= BATTERY_TABLE[i - 1].charge && batteryTableIsSorted(i + 1));
+}
+
+static_assert(batteryTableIsSorted(), "BATTERY_TABLE must be sorted by voltage");
+
+constexpr uint8_t batteryInterpolate(uint16_t millivolts, const BatteryTablePoint& low, const BatteryTablePoint& high) {
+  return low.charge + (uint8_t)((uint32_t)(millivolts - low.millivolts) * (high.charge - low.charge)
+    / (high.millivolts - low.millivolts));
+}
+
+constexpr uint8_t batteryChargeFromMillivolts(uint16_t millivolts, int i = 1) {
+  return millivolts <= BATTERY_TABLE[0].millivolts ? 0
+    : millivolts >= BATTERY_TABLE[BATTERY_TABLE_SIZE - 1].millivolts ? 100
+    : millivolts < BATTERY_TABLE[i].millivolts ? batteryInterpolate(millivolts, BATTERY_TABLE[i - 1], BATTERY_TABLE[i])
+    : batteryChargeFromMillivolts(millivolts, i + 1);
+}
+
+static_assert(batteryChargeFromMillivolts(3000) == 0, "empty below the table");
+static_assert(batteryChargeFromMillivolts(3840) == 50, "table point");
+static_assert(batteryChargeFromMillivolts(4000) == 77, "interpolated between points");
+static_assert(batteryChargeFromMillivolts(5000) == 100, "full above the table, charging on USB");
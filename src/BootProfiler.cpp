@@ -0,0 +1,96 @@
+#include "BootProfiler.h"
+#include <esp_timer.h>
+#include "ESPLogMacros.h"
+
+#define BOOT_PROFILER_MAGIC 0xB0
+
+typedef struct {
+  uint8_t magic;
+  uint16_t bootsSinceReport;
+  PhaseStats phases[BOOT_PHASE_COUNT];
+} BootProfilerState;
+
+RTC_DATA_ATTR static BootProfilerState state;
+static int64_t phaseStartUs[BOOT_PHASE_COUNT]; //zero initialized before any constructor runs
+static const char* phaseNames[BOOT_PHASE_COUNT] = {
+  "startup", "log mount", "serial init", "config load", "channel setup", "espnow init",
+  "water level", "battery", "send", "sleep delay", "awake"
+};
+
+static void ensureInitialized() {
+  if (state.magic == BOOT_PROFILER_MAGIC) return;
+  memset(&state, 0, sizeof(state));
+  state.magic = BOOT_PROFILER_MAGIC;
+}
+
+void BootProfiler::reset() {
+  memset(&state, 0, sizeof(state));
+  state.magic = BOOT_PROFILER_MAGIC;
+}
+
+void BootProfiler::begin(BootPhase phase) {
+  phaseStartUs[phase] = esp_timer_get_time();
+}
+
+void BootProfiler::end(BootPhase phase) {
+  record(phase, (uint32_t)(esp_timer_get_time() - phaseStartUs[phase]));
+}
+
+void BootProfiler::record(BootPhase phase, uint32_t durationUs) {
+  ensureInitialized();
+  PhaseStats& stats = state.phases[phase];
+  if (stats.count == 0 || durationUs < stats.minUs) stats.minUs = durationUs;
+  if (durationUs > stats.maxUs) stats.maxUs = durationUs;
+  stats.sumUs += durationUs;
+  if (stats.count < UINT16_MAX) stats.count++;
+
+  int bucket = 0;
+  for (uint32_t limitUs = 1000; bucket < BOOT_PROFILER_BUCKETS - 1 && durationUs >= limitUs; limitUs *= 10) {
+    bucket++;
+  }
+  if (stats.buckets[bucket] < UINT8_MAX) stats.buckets[bucket]++;
+
+  if (phase == PHASE_AWAKE) {
+    state.bootsSinceReport++;
+  }
+}
+
+void BootProfiler::logSummary() {
+  ensureInitialized();
+  for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+    const PhaseStats& stats = state.phases[i];
+    if (stats.count == 0) continue;
+    ESP_LOGI(PROFILER, "%s: n=%d min=%uus avg=%uus max=%uus", phaseNames[i], stats.count,
+      stats.minUs, (uint32_t)(stats.sumUs / stats.count), stats.maxUs);
+  }
+}
+
+bool BootProfiler::isReportDue() {
+  ensureInitialized();
+  return state.bootsSinceReport >= BOOT_PROFILER_REPORT_INTERVAL;
+}
+
+/**
+ * One FIELD_PHASE_STATS field per phase with samples from phase on, see WireFormat.h for the layout.
+ * All phases do not fit one frame: it ends when the next field would leave no room for the frame
+ * sequence, and phase is left where the next frame starts.
+*/
+bool BootProfiler::encodeReport(FrameEncoder& frame, int& phase) {
+  ensureInitialized();
+  frame.begin(TELEMETRY);
+  for (; phase < BOOT_PHASE_COUNT; phase++) {
+    const PhaseStats& stats = state.phases[phase];
+    if (stats.count == 0) continue;
+    if (frame.fieldCapacity() < WIRE_PHASE_STATS_LEN + WIRE_FRAME_SEQUENCE_LEN) break;
+    uint32_t avgUs = (uint32_t)(stats.sumUs / stats.count);
+    uint8_t value[WIRE_PHASE_STATS_LEN];
+    value[0] = phase;
+    wireWriteU16(&value[1], stats.count);
+    wireWriteU32(&value[3], stats.minUs);
+    wireWriteU32(&value[7], avgUs);
+    wireWriteU32(&value[11], stats.maxUs);
+    memcpy(&value[15], stats.buckets, BOOT_PROFILER_BUCKETS);
+    frame.putBytes(FIELD_PHASE_STATS, value, sizeof(value));
+  }
+  return frame.hasFields();
+}
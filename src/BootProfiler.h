@@ -0,0 +1,43 @@
+#pragma once
+#include <Arduino.h>
+#include <WireFormat.h>
+
+#define BOOT_PROFILER_REPORT_INTERVAL   48 //boots between telemetry reports, one day at 30 min wakes
+#define BOOT_PROFILER_BUCKETS           WIRE_PHASE_STATS_BUCKETS //<1ms, <10ms, <100ms, <1s, <10s, >=10s
+
+enum BootPhase : uint8_t {
+  PHASE_STARTUP,        //reset to setup(), includes global constructors
+  PHASE_LOG_MOUNT,      //LittleFS mount in the PersistentLog constructor
+  PHASE_SERIAL_INIT,
+  PHASE_CONFIG_LOAD,
+  PHASE_CHANNEL_SETUP,  //cached channel or Wi-Fi scan
+  PHASE_ESPNOW_INIT,
+  PHASE_WATER_LEVEL,
+  PHASE_BATTERY,
+  PHASE_SEND,           //flush of the transmit pipeline
+  PHASE_SLEEP_DELAY,
+  PHASE_AWAKE,          //reset to deep sleep
+  BOOT_PHASE_COUNT
+};
+
+typedef struct {
+  uint16_t count;
+  uint32_t minUs;
+  uint32_t maxUs;
+  uint64_t sumUs;
+  uint8_t buckets[BOOT_PROFILER_BUCKETS]; //saturates at 255
+} PhaseStats;
+
+// Times the phases of a wake cycle with esp_timer_get_time() and accumulates
+// min/avg/max and a coarse histogram per phase in RTC memory across deep sleep.
+// Only static state, so it can be used from global constructors.
+class BootProfiler {
+    public:
+        static void begin(BootPhase phase);
+        static void end(BootPhase phase);
+        static void record(BootPhase phase, uint32_t durationUs);
+        static void logSummary();
+        static bool isReportDue();
+        static bool encodeReport(FrameEncoder& frame, int& phase); //false once every phase was encoded
+        static void reset();
+};
@@ -0,0 +1,92 @@
+#include "ChannelCache.h"
+#include <Preferences.h>
+#include "ESPLogMacros.h"
+
+#define CHANNEL_CACHE_MAGIC 0xC4
+
+typedef struct {
+  uint8_t magic;
+  uint8_t channel;
+  uint8_t failedCycles;
+  bool probeRequired;
+  uint16_t cyclesSinceProbe;
+} ChannelCacheState;
+
+RTC_DATA_ATTR static ChannelCacheState state;
+
+ChannelCache::ChannelCache(int maxFailedCycles, int revalidateCycles) {
+  this->maxFailedCycles = maxFailedCycles;
+  this->revalidateCycles = revalidateCycles;
+}
+
+int ChannelCache::loadFromNVS() {
+  Preferences preferences;
+  preferences.begin(CHANNEL_CACHE_NVS_NAMESPACE, true);
+  int channel = preferences.getUChar(CHANNEL_CACHE_NVS_KEY, 0);
+  preferences.end();
+  return channel;
+}
+
+void ChannelCache::saveToNVS(int channel) {
+  Preferences preferences;
+  preferences.begin(CHANNEL_CACHE_NVS_NAMESPACE, false);
+  preferences.putUChar(CHANNEL_CACHE_NVS_KEY, channel);
+  preferences.end();
+}
+
+int ChannelCache::getChannel() {
+  if (state.magic != CHANNEL_CACHE_MAGIC) {
+    // first boot after power loss, RTC memory is empty
+    state.magic = CHANNEL_CACHE_MAGIC;
+    state.channel = loadFromNVS();
+    state.failedCycles = 0;
+    state.probeRequired = false;
+    state.cyclesSinceProbe = 0;
+    ESP_LOGI(CHANNELCACHE, "Channel loaded from NVS: %d", state.channel);
+  }
+  if (state.probeRequired) return 0;
+  return state.channel;
+}
+
+int ChannelCache::getLastChannel() {
+  getChannel(); //loads it after power loss
+  return state.channel;
+}
+
+void ChannelCache::store(int channel) {
+  if (channel <= 0) return;
+  if (state.magic == CHANNEL_CACHE_MAGIC && state.channel != 0 && state.channel != channel) {
+    ESP_LOGW(CHANNELCACHE, "Channel hop detected: %d -> %d", state.channel, channel);
+  }
+  bool changed = state.magic != CHANNEL_CACHE_MAGIC || state.channel != channel;
+  state.magic = CHANNEL_CACHE_MAGIC;
+  state.channel = channel;
+  state.failedCycles = 0;
+  state.probeRequired = false;
+  state.cyclesSinceProbe = 0;
+  if (changed) {
+    saveToNVS(channel); //only written when it changes, to spare flash wear
+  }
+}
+
+void ChannelCache::invalidate() {
+  state.probeRequired = true;
+}
+
+void ChannelCache::reportCycle(bool delivered) {
+  if (state.cyclesSinceProbe < UINT16_MAX) state.cyclesSinceProbe++;
+  if (state.cyclesSinceProbe >= revalidateCycles && !state.probeRequired) {
+    ESP_LOGI(CHANNELCACHE, "Channel %d in use for %d cycles, will be probed again", state.channel, state.cyclesSinceProbe);
+    invalidate();
+  }
+  if (delivered) {
+    state.failedCycles = 0;
+    return;
+  }
+  state.failedCycles++;
+  ESP_LOGW(CHANNELCACHE, "Nothing delivered on channel %d, failed cycles: %d", state.channel, state.failedCycles);
+  if (state.failedCycles >= maxFailedCycles) {
+    ESP_LOGW(CHANNELCACHE, "Channel will be probed again");
+    invalidate();
+  }
+}
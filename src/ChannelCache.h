@@ -0,0 +1,25 @@
+#pragma once
+#include <Arduino.h>
+
+#define CHANNEL_CACHE_NVS_NAMESPACE  "espnow"
+#define CHANNEL_CACHE_NVS_KEY        "channel"
+
+// Remembers the Wi-Fi channel used to reach the gateway, so it doesn't have to be
+// discovered with a scan on every wake. Kept in RTC memory across deep sleep and in
+// NVS across power loss. The cache is invalidated after a number of consecutive
+// cycles where nothing could be delivered, and after revalidateCycles cycles in any
+// case, since an access point can move the gateway to another channel at any time.
+class ChannelCache {
+    public:
+        ChannelCache(int maxFailedCycles, int revalidateCycles);
+        int getChannel(); //0 when the channel must be probed
+        int getLastChannel(); //channel stored last even when a probe is due, 0 when none
+        void store(int channel);
+        void invalidate();
+        void reportCycle(bool delivered);
+    private:
+        int maxFailedCycles;
+        int revalidateCycles;
+        int loadFromNVS();
+        void saveToNVS(int channel);
+};
@@ -95,7 +95,7 @@ void Display::showWifiConnected(char *wifiSSID, const char *localIP) {
     Serial.println(localIP);
 }
 
-void Display::showWaterLevel(int waterLevel) {
+void Display::showWaterLevel(int waterLevel, int fillPercent, bool fillFault) {
     if (!initiated) return;
 
     const char* waterLevelStr = waterLevel == 0 ? "OK" : "LOW";
@@ -104,7 +104,15 @@ void Display::showWaterLevel(int waterLevel) {
     tft.setTextColor(TFT_YELLOW);
     tft.drawString("Water Level is ", tft.width() / 2, tft.height() / 2, 2);
     tft.setTextColor(waterLevel == 0 ? TFT_GREEN : TFT_RED);
-    tft.drawString(String(waterLevelStr), tft.width() / 2, tft.height() / 2 + 40, 4);
+    if (fillPercent < 0) {
+        tft.drawString(String(waterLevelStr), tft.width() / 2, tft.height() / 2 + 40, 4);
+        return;
+    }
+    tft.drawString(String(waterLevelStr) + " " + String(fillPercent) + "%", tft.width() / 2, tft.height() / 2 + 40, 4);
+    if (fillFault) {
+        tft.setTextColor(TFT_ORANGE);
+        tft.drawString("Probe fault", tft.width() / 2, tft.height() / 2 + 70, 2);
+    }
 }
 
 void Display::showTime(char *time) {
@@ -25,7 +25,7 @@ class Display {
         void showInstructions();
         void showConnectingWifi(char *wifiSSID);
         void showWifiConnected(char *wifiSSID, const char *localIP);
-        void showWaterLevel(int waterLevel);
+        void showWaterLevel(int waterLevel, int fillPercent = -1, bool fillFault = false); //fillPercent -1 without probe ladder
         void showScanningWifi();
         void showWifiScanned(char* networksFoundStr[], int networksFoundCount);
         void showBatteryInfo(bool updateCharge, double lastCharge, boolean isCharging, bool updateVoltage, double lastVoltage);
@@ -1,11 +1,53 @@
-#ifdef CORE_DEBUG_LEVEL
-#undef CORE_DEBUG_LEVEL
+// Log front end with compile-time levels per tag. Include it after every other header.
+//
+// The tag is an identifier, not a string: ESP_LOGI(ESPNOW, ...) is only compiled when
+// ESP_LOG_INFO <= LOG_LEVEL_ESPNOW, otherwise the call, its arguments and its format
+// string are dropped by the compiler. Every tag needs its LOG_LEVEL_<tag>, a tag without
+// one does not compile. The levels can be overridden in build_flags, LOG_DISABLED
+// removes every call (see the production environment in platformio.ini).
+#include <esp_log.h>
+
+#ifndef LOG_LEVEL_DEFAULT
+#define LOG_LEVEL_DEFAULT         ESP_LOG_DEBUG
+#endif
+#ifndef LOG_LEVEL_MAIN
+#define LOG_LEVEL_MAIN            LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_ESPNOW
+#define LOG_LEVEL_ESPNOW          LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_APPCONFIG
+#define LOG_LEVEL_APPCONFIG       LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_NTPTIME
+#define LOG_LEVEL_NTPTIME         LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_AGGREGATOR
+#define LOG_LEVEL_AGGREGATOR      LOG_LEVEL_DEFAULT
 #endif
-#define CORE_DEBUG_LEVEL 3
-#ifdef LOG_LOCAL_LEVEL
-#undef LOG_LOCAL_LEVEL
+#ifndef LOG_LEVEL_BATTERY
+#define LOG_LEVEL_BATTERY         LOG_LEVEL_DEFAULT
 #endif
-#define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
+#ifndef LOG_LEVEL_CHANNELCACHE
+#define LOG_LEVEL_CHANNELCACHE    LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_JOBS
+#define LOG_LEVEL_JOBS            LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_PROFILER
+#define LOG_LEVEL_PROFILER        LOG_LEVEL_DEFAULT
+#endif
+
+#ifdef LOG_DISABLED
+#define LOG_TAG_LEVEL(tag)        ESP_LOG_NONE
+#else
+#define LOG_TAG_LEVEL(tag)        LOG_LEVEL_##tag
+#endif
+
+//tag arrives macro-expanded, so LOG_TAG_MAIN works as well as MAIN
+#define LOG_AT(level, tag, format, ...) do { \
+    if ((level) <= LOG_TAG_LEVEL(tag)) ESP_LOG_LEVEL(level, #tag, format, ##__VA_ARGS__); \
+  } while (0)
 
 #ifdef ESP_LOGE
 #undef ESP_LOGE
@@ -22,8 +64,8 @@
 #ifdef ESP_LOGV
 #undef ESP_LOGV
 #endif
-#define ESP_LOGE( tag, format, ... ) ESP_LOG_LEVEL_LOCAL(ESP_LOG_ERROR,   tag, format, ##__VA_ARGS__)
-#define ESP_LOGW( tag, format, ... ) ESP_LOG_LEVEL_LOCAL(ESP_LOG_WARN,    tag, format, ##__VA_ARGS__)
-#define ESP_LOGI( tag, format, ... ) ESP_LOG_LEVEL_LOCAL(ESP_LOG_INFO,    tag, format, ##__VA_ARGS__)
-#define ESP_LOGD( tag, format, ... ) ESP_LOG_LEVEL_LOCAL(ESP_LOG_DEBUG,   tag, format, ##__VA_ARGS__)
-#define ESP_LOGV( tag, format, ... ) ESP_LOG_LEVEL_LOCAL(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
\ No newline at end of file
+#define ESP_LOGE( tag, format, ... ) LOG_AT(ESP_LOG_ERROR,   tag, format, ##__VA_ARGS__)
+#define ESP_LOGW( tag, format, ... ) LOG_AT(ESP_LOG_WARN,    tag, format, ##__VA_ARGS__)
+#define ESP_LOGI( tag, format, ... ) LOG_AT(ESP_LOG_INFO,    tag, format, ##__VA_ARGS__)
+#define ESP_LOGD( tag, format, ... ) LOG_AT(ESP_LOG_DEBUG,   tag, format, ##__VA_ARGS__)
+#define ESP_LOGV( tag, format, ... ) LOG_AT(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
@@ -2,11 +2,25 @@
 #include <WiFi.h>
 #include <esp_wifi.h>
 #include "ESPLogMacros.h"
+#include "BootProfiler.h"
 
-ESPNow::ESPNow() {
+RTC_DATA_ATTR static uint16_t nextFrameSequence = 0; //FIELD_FRAME_SEQUENCE, kept across deep sleep so consecutive cycles never reuse one
+RTC_DATA_ATTR static GatewayTableState gatewayTableState;
+
+ESPNow::ESPNow() : txPipeline(TxPlatform{ &ESPNow::send, &ESPNow::nowMs, &ESPNow::sleepMs, this }),
+  channelCache(ESPNOW_CHANNEL_MAX_FAILED_CYCLES, ESPNOW_CHANNEL_REVALIDATE_CYCLES), gatewayTable(&gatewayTableState) {
+  TxConfig txConfig;
+  txConfig.window = ESPNOW_TX_WINDOW;
+  txConfig.maxRetries = ESPNOW_TX_MAX_RETRIES;
+  txConfig.baseBackoffMs = ESPNOW_TX_BACKOFF_MS;
+  txConfig.maxBackoffMs = ESPNOW_TX_MAX_BACKOFF_MS;
+  txConfig.sendTimeoutMs = ESPNOW_SEND_TIMEOUT_MS;
+  txPipeline.configure(txConfig);
+  txLock = xSemaphoreCreateMutex();
 }
 
 ESPNow::~ESPNow() {
+  vSemaphoreDelete(txLock);
 }
 
 void ESPNow::parseBytes(const char* str, char sep, uint8_t* bytes, int maxBytes, int base) {
@@ -20,69 +34,180 @@ void ESPNow::parseBytes(const char* str, char sep, uint8_t* bytes, int maxBytes,
   }
 }
 
-void ESPNow::configGatewayMacAddress(const char* gatewayMacAddressString) {
+void ESPNow::configGatewayMacAddresses(const char* const* gatewayMacAddressStrings, int count) {
   const int baseHexadecimal = 16;
   const char separator = ':';
-  parseBytes(gatewayMacAddressString, separator, gatewayMacAddress, 6, baseHexadecimal);
+  portENTER_CRITICAL(&gatewayTableLock);
+  gatewayTable.clearConfigured(); //the table outlives deep sleep, the configuration may have changed
+  portEXIT_CRITICAL(&gatewayTableLock);
+  for (int i = 0; i < count; i++) {
+    if (gatewayMacAddressStrings[i] == NULL || gatewayMacAddressStrings[i][0] == '\0') continue;
+    uint8_t macAddress[6];
+    parseBytes(gatewayMacAddressStrings[i], separator, macAddress, 6, baseHexadecimal);
+    portENTER_CRITICAL(&gatewayTableLock);
+    int index = gatewayTable.addConfigured(macAddress);
+    portEXIT_CRITICAL(&gatewayTableLock);
+    if (index < 0) {
+      ESP_LOGW(ESPNOW, "Gateway table full, %s ignored", gatewayMacAddressStrings[i]);
+    }
+  }
+}
+
+void ESPNow::addPeer(const uint8_t* macAddress) {
+  if (esp_now_is_peer_exist(macAddress)) return;
+  memcpy(peerInfo.peer_addr, macAddress, 6);
+  peerInfo.channel = 0;  
+  peerInfo.encrypt = false;
+  if (esp_now_add_peer(&peerInfo) != ESP_OK){
+    ESP_LOGE(ESPNOW, "Failed to add peer");
+  }
+}
+
+/**
+ * Targets the gateway with the best delivery record
+*/
+void ESPNow::selectGateway() {
+  currentGateway = gatewayTable.best();
+  if (currentGateway < 0) {
+    ESP_LOGE(ESPNOW, "No gateway available");
+    return;
+  }
+  const uint8_t* mac = gatewayTable.get(currentGateway).mac;
+  memcpy(gatewayMacAddress, mac, 6);
+  ESP_LOGI(ESPNOW, "Using gateway %02x:%02x:%02x:%02x:%02x:%02x (score %d)",
+    mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], gatewayTable.score(currentGateway));
+}
+
+/**
+ * Broadcasts a DISCOVERY frame and adds every gateway that answers within ESPNOW_DISCOVERY_WINDOW_MS
+*/
+int ESPNow::discoverGateways() {
+  ESP_LOGI(ESPNOW, "Broadcasting gateway discovery");
+  addPeer(espNow_broadcastAddress);
+  portENTER_CRITICAL(&discoveryLock);
+  discoveryReplyCount = 0;
+  discovering = true;
+  portEXIT_CRITICAL(&discoveryLock);
+
+  uint8_t frameBuffer[WIRE_HEADER_LEN];
+  FrameEncoder frame(frameBuffer, sizeof(frameBuffer));
+  frame.begin(DISCOVERY);
+  esp_now_send(espNow_broadcastAddress, frame.data(), frame.length());
+  delay(ESPNOW_DISCOVERY_WINDOW_MS);
+
+  portENTER_CRITICAL(&discoveryLock);
+  discovering = false;
+  int replyCount = discoveryReplyCount;
+  portEXIT_CRITICAL(&discoveryLock);
+
+  ESP_LOGI(ESPNOW, "%d gateways answered the discovery", replyCount);
+  for (int i = 0; i < replyCount; i++) {
+    portENTER_CRITICAL(&gatewayTableLock);
+    int index = gatewayTable.addDiscovered(discoveryReplies[i].mac, discoveryReplies[i].rssi);
+    portEXIT_CRITICAL(&gatewayTableLock);
+    if (index >= 0) {
+      addPeer(discoveryReplies[i].mac);
+    }
+  }
+  return replyCount;
+}
+
+/**
+ * Broadcasts a discovery on every channel until a gateway answers, for when the SSID scan found nothing.
+ * Falls back to the last known channel, the cache stays due for a probe so the next wake tries again.
+*/
+void ESPNow::sweepChannels() {
+  channelPending = false;
+  for (int channel = 1; channel <= ESPNOW_MAX_CHANNEL; channel++) {
+    configEspNowChannel(channel);
+    if (discoverGateways() > 0) {
+      ESP_LOGI(ESPNOW, "Gateway found on channel %d", channel);
+      channelCache.store(channel);
+      return;
+    }
+  }
+  int lastChannel = channelCache.getLastChannel();
+  ESP_LOGE(ESPNOW, "No gateway answered on any channel, using channel %d", lastChannel);
+  if (lastChannel > 0) configEspNowChannel(lastChannel);
 }
 
 int32_t ESPNow::getWiFiChannel(const char *ssid) {
-  ESP_LOGI("ESPNOW", "Searching for WiFi with SSID '%s'", ssid);
+  ESP_LOGI(ESPNOW, "Searching for WiFi with SSID '%s'", ssid);
   if (int32_t n = WiFi.scanNetworks()) {
     for (uint8_t i=0; i<n; i++) {
       if (strcmp(ssid, WiFi.SSID(i).c_str()) == 0) {
         int32_t wifiChannel = WiFi.channel(i);
-        ESP_LOGI("ESPNOW", "WiFi channel for SSID '%s' found: %d", ssid, wifiChannel);
+        ESP_LOGI(ESPNOW, "WiFi channel for SSID '%s' found: %d", ssid, wifiChannel);
         return wifiChannel;
       }
     }
   }
-  ESP_LOGE("ESPNOW", "WiFi channel for SSID '%s' not found!", ssid);
+  ESP_LOGE(ESPNOW, "WiFi channel for SSID '%s' not found!", ssid);
   return 0;
 }
 
 void ESPNow::configEspNowChannel(int wifiChannel) {
-  ESP_LOGI("ESPNOW", "Config ESPNow WiFi channel to %d", wifiChannel);
+  if (wifiChannel < 1 || wifiChannel > ESPNOW_MAX_CHANNEL) {
+    ESP_LOGE(ESPNOW, "Invalid WiFi channel %d, channel left unchanged", wifiChannel);
+    return;
+  }
+  ESP_LOGI(ESPNOW, "Config ESPNow WiFi channel to %d", wifiChannel);
   esp_wifi_set_channel(wifiChannel, WIFI_SECOND_CHAN_NONE);
-  uint8_t* chan;
-  wifi_second_chan_t* sChan;
-  esp_wifi_get_channel(chan, sChan);
-  ESP_LOGI("ESPNOW", "ESPNow WiFi channel set to %d", wifiChannel);
+  uint8_t chan;
+  wifi_second_chan_t sChan;
+  esp_wifi_get_channel(&chan, &sChan);
+  ESP_LOGI(ESPNOW, "ESPNow WiFi channel set to %d", chan);
 }
 
+/**
+ * Uses the channel cached from a previous wake, scanning for the SSID only when there is none
+ * or the cache is due for a probe. When the SSID is not found the channels are swept in init().
+*/
 void ESPNow::configEspNowChannel(const char *wifiSSID) {
-  ESP_LOGI("ESPNOW", "Config ESPNow WiFi channel to channel used by SSID %s", wifiSSID);
-  int32_t wifiChannel = getWiFiChannel(wifiSSID);
-  esp_wifi_set_channel(wifiChannel, WIFI_SECOND_CHAN_NONE);
-  uint8_t* chan;
-  wifi_second_chan_t* sChan;
-  esp_wifi_get_channel(chan, sChan);
-  ESP_LOGI("ESPNOW", "ESPNow WiFi channel set to %d", wifiChannel);
+  int32_t wifiChannel = channelCache.getChannel();
+  if (wifiChannel > 0) {
+    ESP_LOGI(ESPNOW, "Using cached WiFi channel %d", wifiChannel);
+  } else {
+    ESP_LOGI(ESPNOW, "Config ESPNow WiFi channel to channel used by SSID %s", wifiSSID);
+    wifiChannel = getWiFiChannel(wifiSSID);
+    if (wifiChannel <= 0) {
+      channelPending = true;
+      return;
+    }
+    channelCache.store(wifiChannel);
+  }
+  configEspNowChannel(wifiChannel);
 }
 
-void ESPNow::init(const char* gatewayMacAddressString) {
-  configGatewayMacAddress(gatewayMacAddressString);
+void ESPNow::init(const char* const* gatewayMacAddressStrings, int gatewayCount) {
+  BootProfiler::begin(PHASE_ESPNOW_INIT);
+  configGatewayMacAddresses(gatewayMacAddressStrings, gatewayCount);
 
   // Init ESP-NOW
   if (esp_now_init() != ESP_OK) {
-    ESP_LOGE("ESPNOW", "Error initializing ESP-NOW");
+    ESP_LOGE(ESPNOW, "Error initializing ESP-NOW");
+    BootProfiler::end(PHASE_ESPNOW_INIT);
     return;
   }
 
   // Once ESPNow is successfully Init, we will register for Send CB to
   // get the status of Trasnmitted packet
   esp_now_register_send_cb(ESPNow_OnDataSent);
+  esp_now_register_recv_cb(ESPNow_OnDataRecv);
   
-  // Register peer
-  memcpy(peerInfo.peer_addr, gatewayMacAddress, 6);
-  peerInfo.channel = 0;  
-  peerInfo.encrypt = false;
-  
-  // Add peer        
-  if (esp_now_add_peer(&peerInfo) != ESP_OK){
-    ESP_LOGE("ESPNOW", "Failed to add peer");
-    return;
+  // Register known gateways as peers
+  for (int i = 0; i < gatewayTable.getCount(); i++) {
+    addPeer(gatewayTable.get(i).mac);
+  }
+  BootProfiler::end(PHASE_ESPNOW_INIT);
+
+  if (channelPending) {
+    sweepChannels();
+  }
+  if (gatewayTable.getCount() == 0 || gatewayTable.allFailing()) {
+    discoverGateways();
   }
+  selectGateway();
 }
 
 /**
@@ -91,59 +216,150 @@ void ESPNow::init(const char* gatewayMacAddressString) {
 void ESPNow::init(const char* gatewayMacAddressString, int wifiChannel) {
   WiFi.mode(WIFI_STA);
   configEspNowChannel(wifiChannel);
-  init(gatewayMacAddressString);
+  init(&gatewayMacAddressString, 1);
 }
 
 /**
  * 
 */
 void ESPNow::init(const char* gatewayMacAddressString, const char* wifiSSIDToGetChannelFrom) {
-  ESP_LOGI("ESPNOW", "Initiating with Gateway: %s, WIFI SSID: %s", gatewayMacAddressString, wifiSSIDToGetChannelFrom);
+  init(&gatewayMacAddressString, 1, wifiSSIDToGetChannelFrom);
+}
+
+/**
+ * Gateways are ranked by their delivery record, the best one is used for sending
+*/
+void ESPNow::init(const char* const* gatewayMacAddressStrings, int gatewayCount, const char* wifiSSIDToGetChannelFrom) {
+  ESP_LOGI(ESPNOW, "Initiating with %d configured gateways, WIFI SSID: %s", gatewayCount, wifiSSIDToGetChannelFrom);
   WiFi.mode(WIFI_STA);
+  BootProfiler::begin(PHASE_CHANNEL_SETUP);
   configEspNowChannel(wifiSSIDToGetChannelFrom);
-  init(gatewayMacAddressString);
+  BootProfiler::end(PHASE_CHANNEL_SETUP);
+  init(gatewayMacAddressStrings, gatewayCount);
 }
 
-void ESPNow::send() {
-  // Send message via ESP-NOW
-  
-  esp_err_t result = esp_now_send(gatewayMacAddress, (uint8_t *) &myData, sizeof(myData));
+int ESPNow::send(const uint8_t* frame, size_t length, void* context) {
+  // Send message via ESP-NOW, only the used bytes of the frame go on air
+  ESPNow* self = (ESPNow*)context;
+  esp_err_t result = esp_now_send(self->gatewayMacAddress, frame, length);
   
   if (result == ESP_OK) {
-    ESP_LOGI("ESPNOW", "Sent with success");
+    ESP_LOGI(ESPNOW, "Sent with success (%d bytes)", length);
+    return 0;
   }
-  else {
-    ESP_LOGE("ESPNOW", "Error sending the data");
+  ESP_LOGE(ESPNOW, "Error sending the data: %s", esp_err_to_name(result));
+  return result;
+}
+
+uint32_t ESPNow::nowMs(void* context) {
+  return millis();
+}
+
+void ESPNow::sleepMs(uint32_t ms, void* context) {
+  delay(ms);
+}
+
+/**
+ * Copies the frame into a transmit slot and stamps it with the next frame sequence number,
+ * which stays the same when the pipeline retries it. A frame without room for it goes unstamped.
+*/
+bool ESPNow::sendFrame(const FrameEncoder& frame) {
+  xSemaphoreTake(txLock, portMAX_DELAY);
+  bool queued = false;
+  uint8_t* slot = txPipeline.acquire(ESPNOW_SLOT_WAIT_MS);
+  if (slot == NULL) {
+    ESP_LOGE(ESPNOW, "No free transmit slot, frame dropped");
+  } else {
+    memcpy(slot, frame.data(), frame.length());
+    FrameEncoder stamped(slot, TX_PIPELINE_FRAME_LEN);
+    stamped.resume(frame.length());
+    if (stamped.putU16(FIELD_FRAME_SEQUENCE, nextFrameSequence)) nextFrameSequence++;
+    queued = txPipeline.submit(slot, stamped.length());
   }
+  xSemaphoreGive(txLock);
+  return queued;
 }
 
 /**
- * 
+ * Waits for every pending frame to be confirmed, retrying failed ones, for at most deadlineMs
 */
-void ESPNow::sendMessage(std::string message, msgType messageType) {
-  int bufferSize = sizeof(myData.content);
-  size_t messageLength = message.length(); //without null termination
+bool ESPNow::flush(uint32_t deadlineMs) {
+  xSemaphoreTake(txLock, portMAX_DELAY);
+  bool allSent = txPipeline.flush(deadlineMs);
+  const TxCounters& counters = txPipeline.getCounters();
+  ESP_LOGI(ESPNOW, "TX queued: %d, attempts: %d, delivered: %d, retries: %d, failed: %d, rejected: %d, timeouts: %d (%d late), flush: %dms%s",
+    counters.queued, counters.attempts, counters.delivered, counters.retries, counters.failed,
+    counters.rejected, counters.timeouts, counters.late, counters.flushMs, counters.deadlineExpired ? " (deadline expired)" : "");
+  reportCycle();
+  xSemaphoreGive(txLock);
+  return allSent;
+}
 
-  ESP_LOGI("ESPNOW", "Content of message being sent has %d bytes", messageLength);
+void ESPNow::reportCycle() {
+  const TxCounters& counters = txPipeline.getCounters();
+  bool delivered = counters.delivered != reportedDelivered;
+  bool failed = counters.failed != reportedFailed;
+  reportedDelivered = counters.delivered;
+  reportedFailed = counters.failed;
+  if (delivered || failed) {
+    channelCache.reportCycle(delivered);
+    gatewayTable.reportResult(currentGateway, delivered);
+    if (!delivered) {
+      portENTER_CRITICAL(&gatewayTableLock);
+      int removed = gatewayTable.removeStale();
+      portEXIT_CRITICAL(&gatewayTableLock);
+      if (removed > 0) ESP_LOGW(ESPNOW, "%d gateways stopped answering, removed", removed);
+      selectGateway(); //fail over if another gateway now ranks higher
+    }
+  }
+}
 
-  int numberOfParts = 1;
-  if (messageLength >= bufferSize) {
-    div_t division = std::div(messageLength, bufferSize - 1);
-    numberOfParts = division.quot + (division.rem > 0 ? 1 : 0);
+void ESPNow::onDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
+  bool success = status == ESP_NOW_SEND_SUCCESS;
+  if (memcmp(mac_addr, espNow_broadcastAddress, 6) == 0) return; //discovery broadcast, not part of the pipeline
+  txPipeline.onSendComplete(success);
+  ESP_LOGI(ESPNOW, "Last Packet Send Confirmation Status: %s", success ? "Success" : "Failed");
+}
+void ESPNow::onDataRecv(const esp_now_recv_info_t *info, const uint8_t *data, int len) {
+  FrameDecoder decoder(data, len);
+  if (!decoder.isValid()) return;
+  if (decoder.type() == LOG_REQUEST) {
+    //runs on the Wi-Fi task, the table may be rearranged meanwhile
+    portENTER_CRITICAL(&gatewayTableLock);
+    bool fromGateway = gatewayTable.find(info->src_addr) >= 0;
+    portEXIT_CRITICAL(&gatewayTableLock);
+    if (fromGateway) onLogRequest(decoder); //only gateways may pull the log
+    return;
+  }
+  //requests of other sensors looking for a gateway are no answer
+  if (decoder.type() != DISCOVERY || (decoder.flags() & WIRE_FLAG_REPLY) == 0) return;
+  portENTER_CRITICAL(&discoveryLock);
+  if (discovering && discoveryReplyCount < GATEWAY_TABLE_SIZE) {
+    memcpy(discoveryReplies[discoveryReplyCount].mac, info->src_addr, 6);
+    discoveryReplies[discoveryReplyCount].rssi = info->rx_ctrl != NULL ? info->rx_ctrl->rssi : 0;
+    discoveryReplyCount++;
   }
-  ESP_LOGI("ESPNOW", "Number of parts: %d", numberOfParts);
+  portEXIT_CRITICAL(&discoveryLock);
+}
 
-  for(int i=0; i < numberOfParts; i++) {
-    const char* substring = message.substr(bufferSize*i).c_str();
-    strncpy(myData.content, substring, bufferSize);
-    myData.content[bufferSize - 1] = 0; //null termination
-    myData.type = messageType;
-    myData.page = numberOfParts == 1 ? 0 : i + 1;
-    send();
+void ESPNow::onLogRequest(FrameDecoder& decoder) {
+  WireField field;
+  while (decoder.nextField(field)) {
+    if (field.tag != FIELD_LOG_RANGE || field.length < WIRE_LOG_RANGE_LEN) continue;
+    portENTER_CRITICAL(&logRequestLock);
+    logRequestFrom = wireReadU32(field.value);
+    logRequestTo = wireReadU32(&field.value[4]);
+    hasLogRequest = true;
+    portEXIT_CRITICAL(&logRequestLock);
   }
 }
 
-void ESPNow::onDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
-  bool success = status == ESP_NOW_SEND_SUCCESS;
-  ESP_LOGI("ESPNOW", "Last Packet Send Confirmation Status: %s", success ? "Success" : "Failed");
-}
\ No newline at end of file
+bool ESPNow::takeLogRequest(uint32_t& from, uint32_t& to) {
+  portENTER_CRITICAL(&logRequestLock);
+  bool requested = hasLogRequest;
+  from = logRequestFrom;
+  to = logRequestTo;
+  hasLogRequest = false;
+  portEXIT_CRITICAL(&logRequestLock);
+  return requested;
+}
@@ -1,44 +1,76 @@
-#include <string>
 #include <esp_now.h>
+#include <WireFormat.h>
+#include <TxPipeline.h>
+#include "ChannelCache.h"
+#include "GatewayTable.h"
 
-#define MAX_MESSAGE_LENGTH 240
+#define ESPNOW_TX_WINDOW            2   //frames waiting for send confirmation at once
+#define ESPNOW_TX_MAX_RETRIES       3
+#define ESPNOW_TX_BACKOFF_MS        10  //first retry delay, doubled on every retry
+#define ESPNOW_TX_MAX_BACKOFF_MS    80
+#define ESPNOW_SEND_TIMEOUT_MS      100 //frame without send confirmation is considered failed
+#define ESPNOW_SLOT_WAIT_MS         300 //max time waiting for a free transmit slot
+#define ESPNOW_CHANNEL_MAX_FAILED_CYCLES  3 //cycles without any delivery before the cached channel is probed again
+#define ESPNOW_CHANNEL_REVALIDATE_CYCLES  96 //cycles before the cached channel is probed again even if it works
+#define ESPNOW_MAX_CHANNEL          13  //highest channel swept for a gateway when the SSID is not found
+#define ESPNOW_DISCOVERY_WINDOW_MS  60  //time waiting for gateways to answer a discovery broadcast
 
 void ESPNow_OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status); // MUST be implemented in your sketch. Called after data is sent.
+void ESPNow_OnDataRecv(const esp_now_recv_info_t *info, const uint8_t *data, int len); // MUST be implemented in your sketch. Called when data is received.
 
 const uint8_t espNow_broadcastAddress[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 
-enum msgType : uint {
-  SENSOR_INFO = 1,
-  LOG = 2,
-  COMMAND = 3
-};
-
-// Structure example to send data
-// Must match the receiver structure
-// total struct size has to be max ESP_NOW_MAX_DATA_LEN bytes
-typedef struct struct_message {
-  char content[MAX_MESSAGE_LENGTH];
-  msgType type;
-  int page; //0 = single page message, -1 = last page, 1-n = current page of multipage message
-} struct_message;
 
 class ESPNow {
     public:
         ESPNow();
         ~ESPNow();
         void init(const char* gatewayMacAddressString, const char* wifiSSIDToGetChannelFrom);
+        void init(const char* const* gatewayMacAddressStrings, int gatewayCount, const char* wifiSSIDToGetChannelFrom);
         void init(const char* gatewayMacAddressString, int wifiChannel);
-        void sendMessage(std::string message, msgType messageType);
+        bool sendFrame(const FrameEncoder& frame); //false when the frame was dropped
         void onDataSent(const uint8_t *mac_addr, esp_now_send_status_t status);
+        void onDataRecv(const esp_now_recv_info_t *info, const uint8_t *data, int len);
+        int discoverGateways(); //number of gateways that answered
+        bool flush(uint32_t deadlineMs);
+        bool takeLogRequest(uint32_t& from, uint32_t& to); //latest LOG_REQUEST of the gateway, once
+        const TxCounters& getTxCounters() { return txPipeline.getCounters(); };
+        void resetTxCounters() { txPipeline.resetCounters(); };
     private:
         uint8_t gatewayMacAddress[6];
-        struct_message myData;
+        TxPipeline txPipeline;
+        SemaphoreHandle_t txLock;
+        ChannelCache channelCache;
+        bool channelPending = false; //SSID not found, the channel is swept once ESP-NOW runs
+        void sweepChannels();
+        uint16_t reportedDelivered = 0;
+        uint16_t reportedFailed = 0;
+        void reportCycle();
         esp_now_peer_info_t peerInfo;
+        GatewayTable gatewayTable;
+        portMUX_TYPE gatewayTableLock = portMUX_INITIALIZER_UNLOCKED; //onDataRecv looks gateways up on the Wi-Fi task
+        int currentGateway = -1;
+        portMUX_TYPE discoveryLock = portMUX_INITIALIZER_UNLOCKED;
+        bool discovering = false;
+        int discoveryReplyCount = 0;
+        struct {
+          uint8_t mac[6];
+          int8_t rssi;
+        } discoveryReplies[GATEWAY_TABLE_SIZE];
+        portMUX_TYPE logRequestLock = portMUX_INITIALIZER_UNLOCKED;
+        bool hasLogRequest = false;
+        uint32_t logRequestFrom;
+        uint32_t logRequestTo;
+        void onLogRequest(FrameDecoder& decoder);
         void parseBytes(const char* str, char sep, uint8_t* bytes, int maxBytes, int base);
-        void configGatewayMacAddress(const char* macAddressString);
-        void send();
+        void configGatewayMacAddresses(const char* const* macAddressStrings, int count);
+        void addPeer(const uint8_t* macAddress);
+        void selectGateway();
+        static int send(const uint8_t* frame, size_t length, void* context);
+        static uint32_t nowMs(void* context);
+        static void sleepMs(uint32_t ms, void* context);
         int32_t getWiFiChannel(const char *ssid);
         void configEspNowChannel(const char *wifiSSID);
         void configEspNowChannel(int wifiChannel);
-        void init(const char* gatewayMacAddressString);
+        void init(const char* const* gatewayMacAddressStrings, int gatewayCount);
 };
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "Esp32JobRunner.h"
+#include <Arduino.h>
+#include <freertos/event_groups.h>
+#include "ESPLogMacros.h"
+
+typedef struct {
+  const Job* job;
+  uint32_t bit;
+  EventGroupHandle_t events;
+} JobTask;
+
+static void runJob(JobTask* task) {
+  if (task->job->dependencies != 0) {
+    xEventGroupWaitBits(task->events, task->job->dependencies, pdFALSE, pdTRUE, portMAX_DELAY);
+  }
+  if (task->job->run != NULL) task->job->run(task->job->context);
+  xEventGroupSetBits(task->events, task->bit);
+}
+
+static void jobTask(void* arg) {
+  runJob((JobTask*)arg);
+  vTaskDelete(NULL);
+}
+
+void runJobGraph(const JobGraph& graph) {
+  EventGroupHandle_t events = xEventGroupCreate();
+  if (events == NULL) {
+    ESP_LOGE(JOBS, "No memory for the event group, running jobs serially");
+    const_cast<JobGraph&>(graph).runSerial();
+    return;
+  }
+  JobTask tasks[JOB_GRAPH_MAX_JOBS];
+  UBaseType_t priority = uxTaskPriorityGet(NULL);
+  for (int i = 0; i < graph.getCount(); i++) {
+    tasks[i].job = &graph.get(i);
+    tasks[i].bit = JOB_BIT(i);
+    tasks[i].events = events;
+    if (xTaskCreate(jobTask, tasks[i].job->name, tasks[i].job->stackSize, &tasks[i], priority, NULL) != pdPASS) {
+      //the caller takes the job, earlier jobs are already running so its dependencies still complete
+      ESP_LOGW(JOBS, "Could not start a task for job %s, running it inline", tasks[i].job->name);
+      runJob(&tasks[i]);
+    }
+  }
+  xEventGroupWaitBits(events, graph.getAllBits(), pdFALSE, pdTRUE, portMAX_DELAY);
+  vEventGroupDelete(events);
+}
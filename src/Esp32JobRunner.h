@@ -0,0 +1,7 @@
+#pragma once
+#include "JobGraph.h"
+
+// Runs every job of the graph in its own FreeRTOS task. Each task waits on an event
+// group for the bits of its dependencies and sets its own bit when done; the caller
+// returns once all bits are set.
+void runJobGraph(const JobGraph& graph);
@@ -0,0 +1,43 @@
+#include "Esp32WakeHal.h"
+#include <Arduino.h>
+#include <esp_sleep.h>
+#include <driver/rtc_io.h>
+#include <esp_rtc_time.h>
+
+static WakeCause wakeCause(void* context) {
+  switch (esp_sleep_get_wakeup_cause()) {
+    case ESP_SLEEP_WAKEUP_UNDEFINED:
+      return WAKE_CAUSE_POWER_ON;
+    case ESP_SLEEP_WAKEUP_TIMER:
+      return WAKE_CAUSE_TIMER;
+    case ESP_SLEEP_WAKEUP_EXT0:
+      return WAKE_CAUSE_BUTTON;
+    case ESP_SLEEP_WAKEUP_EXT1:
+      return WAKE_CAUSE_SENSOR; //the sensor pin is the only ext1 source
+    default:
+      return WAKE_CAUSE_OTHER;
+  }
+}
+
+static void enableTimerWakeup(uint32_t seconds, void* context) {
+  esp_sleep_enable_timer_wakeup((uint64_t)seconds * 1000 * 1000);
+}
+
+static void enablePinWakeup(uint8_t pin, uint8_t level, void* context) {
+  //the pull-up of the switch must stay on while sleeping
+  rtc_gpio_pullup_en((gpio_num_t)pin);
+  rtc_gpio_pulldown_dis((gpio_num_t)pin);
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+  esp_sleep_enable_ext1_wakeup(1ULL << pin, level ? ESP_EXT1_WAKEUP_ANY_HIGH : ESP_EXT1_WAKEUP_ALL_LOW);
+}
+
+static void enableButtonWakeup(uint8_t pin, uint8_t level, void* context) {
+  esp_sleep_enable_ext0_wakeup((gpio_num_t)pin, level);
+}
+
+//the RTC timer of monotonicSeconds() in main, time(NULL) would jump when NTP sets the clock
+static uint32_t nowS(void* context) {
+  return (uint32_t)(esp_rtc_get_time_us() / 1000000ULL);
+}
+
+const WakeHal esp32WakeHal = { &wakeCause, &enableTimerWakeup, &enablePinWakeup, &enableButtonWakeup, &nowS, NULL };
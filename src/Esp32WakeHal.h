@@ -0,0 +1,5 @@
+#pragma once
+#include "WakeRouter.h"
+
+// WakeHal on top of the ESP32 sleep API: ext0 for the button, ext1 for the sensor pin.
+extern const WakeHal esp32WakeHal;
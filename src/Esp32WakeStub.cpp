@@ -0,0 +1,55 @@
+#include "Esp32WakeStub.h"
+#include "WakeStub.h"
+#include <esp_sleep.h>
+#include <esp_wake_stub.h>
+#include <esp_attr.h>
+#include <soc/rtc.h>
+#include <soc/rtc_cntl_reg.h>
+#include <soc/rtc_io_reg.h>
+#include <driver/rtc_io.h>
+
+RTC_DATA_ATTR static WakeStubState wakeStubState;
+RTC_DATA_ATTR static uint32_t wakeStubRtcIoMask; //RTC_GPIO_IN_REG bit of the sensor pin
+
+static void RTC_IRAM_ATTR wakeStub() {
+  bool timerWake = (esp_wake_stub_get_wakeup_cause() & RTC_TIMER_TRIG_EN) != 0;
+  uint32_t rtcIoLevels = REG_GET_FIELD(RTC_GPIO_IN_REG, RTC_GPIO_IN_NEXT);
+  uint8_t sensorLevel = (rtcIoLevels & wakeStubRtcIoMask) ? 1 : 0;
+  if (wakeStubDecide(&wakeStubState, timerWake, sensorLevel) == WAKE_STUB_SLEEP) {
+    esp_wake_stub_set_wakeup_time(wakeStubState.intervalUs);
+    esp_wake_stub_sleep(&wakeStub);
+  }
+  esp_default_wake_deep_sleep();
+}
+
+void wakeStubArm(uint8_t sensorPin, uint8_t sensorLevel, uint16_t skips, uint32_t intervalS) {
+  int rtcIo = rtc_io_number_get((gpio_num_t)sensorPin);
+  if (rtcIo < 0 || skips == 0) {
+    wakeStubDisarm();
+    return;
+  }
+  //the pad stays readable from the RTC domain while sleeping
+  rtc_gpio_init((gpio_num_t)sensorPin);
+  rtc_gpio_set_direction((gpio_num_t)sensorPin, RTC_GPIO_MODE_INPUT_ONLY);
+  rtc_gpio_pullup_en((gpio_num_t)sensorPin);
+  rtc_gpio_pulldown_dis((gpio_num_t)sensorPin);
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+
+  wakeStubRtcIoMask = 1UL << rtcIo;
+  wakeStubState.expectedLevel = sensorLevel;
+  wakeStubState.remainingSkips = skips;
+  wakeStubState.intervalUs = (uint64_t)intervalS * 1000 * 1000;
+  wakeStubState.armed = true;
+  esp_set_deep_sleep_wake_stub(&wakeStub);
+}
+
+void wakeStubDisarm() {
+  wakeStubState.armed = false;
+  esp_set_deep_sleep_wake_stub(NULL);
+}
+
+uint16_t wakeStubTakeSkippedWakes() {
+  uint16_t skipped = wakeStubState.skippedWakes;
+  wakeStubState.skippedWakes = 0;
+  return skipped;
+}
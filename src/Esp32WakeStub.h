@@ -0,0 +1,7 @@
+#pragma once
+#include <stdint.h>
+
+// Deep sleep wake stub reading the sensor pin straight from the RTC IO registers.
+void wakeStubArm(uint8_t sensorPin, uint8_t sensorLevel, uint16_t skips, uint32_t intervalS);
+void wakeStubDisarm();
+uint16_t wakeStubTakeSkippedWakes(); //wakes the stub sent back to sleep since the last call
@@ -0,0 +1,112 @@
+#include "GatewayTable.h"
+#include <string.h>
+
+GatewayTable::GatewayTable(GatewayTableState* state) {
+  this->state = state;
+  if (state->count > GATEWAY_TABLE_SIZE) {
+    memset(state, 0, sizeof(GatewayTableState));
+  }
+}
+
+int GatewayTable::find(const uint8_t* mac) const {
+  for (int i = 0; i < state->count; i++) {
+    if (memcmp(state->entries[i].mac, mac, 6) == 0) return i;
+  }
+  return -1;
+}
+
+int GatewayTable::add(const uint8_t* mac) {
+  int index = find(mac);
+  if (index >= 0) return index;
+  if (state->count < GATEWAY_TABLE_SIZE) {
+    index = state->count++;
+  } else {
+    // table full, replace the worst discovered gateway
+    for (int i = 0; i < state->count; i++) {
+      if (state->entries[i].configured) continue;
+      if (index < 0 || score(i) < score(index)) index = i;
+    }
+    if (index < 0) return -1;
+  }
+  GatewayEntry& entry = state->entries[index];
+  memset(&entry, 0, sizeof(entry));
+  memcpy(entry.mac, mac, 6);
+  return index;
+}
+
+void GatewayTable::clearConfigured() {
+  for (int i = 0; i < state->count; i++) {
+    state->entries[i].configured = false;
+  }
+}
+
+int GatewayTable::addConfigured(const uint8_t* mac) {
+  int index = add(mac);
+  if (index >= 0) state->entries[index].configured = true;
+  return index;
+}
+
+int GatewayTable::addDiscovered(const uint8_t* mac, int8_t rssi) {
+  int index = add(mac);
+  if (index >= 0) {
+    state->entries[index].rssi = rssi;
+    state->entries[index].consecutiveFailures = 0; //it just answered
+  }
+  return index;
+}
+
+/**
+ * Delivery ratio in per mille, minus a penalty per consecutive failure,
+ * plus a small bonus for a stronger signal on the last discovery
+*/
+int GatewayTable::score(int index) const {
+  const GatewayEntry& entry = state->entries[index];
+  int ratio = (entry.successes + 1) * 1000 / (entry.successes + entry.failures + 2);
+  int penalty = entry.consecutiveFailures * 1000 / GATEWAY_TABLE_FAILOVER_FAILURES;
+  int signal = entry.rssi == 0 ? 0 : (entry.rssi + 100) * 2;
+  return ratio - penalty + signal;
+}
+
+int GatewayTable::best() const {
+  int found = -1;
+  for (int i = 0; i < state->count; i++) {
+    if (found < 0 || score(i) > score(found)) found = i;
+  }
+  return found;
+}
+
+bool GatewayTable::allFailing() const {
+  for (int i = 0; i < state->count; i++) {
+    if (state->entries[i].consecutiveFailures < GATEWAY_TABLE_FAILOVER_FAILURES) return false;
+  }
+  return true;
+}
+
+void GatewayTable::reportResult(int index, bool delivered) {
+  if (index < 0 || index >= state->count) return;
+  GatewayEntry& entry = state->entries[index];
+  if (delivered) {
+    entry.successes++;
+    entry.consecutiveFailures = 0;
+  } else {
+    entry.failures++;
+    if (entry.consecutiveFailures < UINT8_MAX) entry.consecutiveFailures++;
+  }
+  if (entry.successes + entry.failures > GATEWAY_TABLE_HISTORY) {
+    entry.successes /= 2;
+    entry.failures /= 2;
+  }
+}
+
+int GatewayTable::removeStale() {
+  int kept = 0;
+  for (int i = 0; i < state->count; i++) {
+    const GatewayEntry& entry = state->entries[i];
+    if (!entry.configured && entry.consecutiveFailures >= GATEWAY_TABLE_STALE_FAILURES) continue;
+    if (kept != i) state->entries[kept] = entry;
+    kept++;
+  }
+  int removed = state->count - kept;
+  state->count = kept;
+  return removed;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define GATEWAY_TABLE_SIZE              4
+#define GATEWAY_TABLE_FAILOVER_FAILURES 2  //consecutive failed cycles before a gateway is ranked below the others
+#define GATEWAY_TABLE_HISTORY           32 //successes + failures kept before older results are halved
+#define GATEWAY_TABLE_STALE_FAILURES    6  //consecutive failed cycles before a discovered gateway is dropped
+
+typedef struct {
+  uint8_t mac[6];
+  bool configured;          //from config.json, never evicted while it is listed there
+  uint16_t successes;
+  uint16_t failures;
+  uint8_t consecutiveFailures;
+  int8_t rssi;              //from the last discovery reply, 0 when unknown
+} GatewayEntry;
+
+typedef struct {
+  uint8_t count;
+  GatewayEntry entries[GATEWAY_TABLE_SIZE];
+} GatewayTableState;
+
+// Ranked list of gateways the sensor can report to, with per gateway delivery statistics.
+// State lives in a caller provided struct, normally kept in RTC memory. Discovered
+// gateways that stop answering are dropped, so are configured ones once they are no
+// longer in the configuration: call clearConfigured() before adding them again.
+class GatewayTable {
+    public:
+        GatewayTable(GatewayTableState* state);
+        void clearConfigured();
+        int addConfigured(const uint8_t* mac);
+        int addDiscovered(const uint8_t* mac, int8_t rssi);
+        int find(const uint8_t* mac) const;
+        int best() const; //-1 when the table is empty
+        bool allFailing() const;
+        void reportResult(int index, bool delivered);
+        int removeStale(); //number of gateways dropped, indexes change when it is not 0
+        int score(int index) const;
+        int getCount() const { return state->count; };
+        const GatewayEntry& get(int index) const { return state->entries[index]; };
+    private:
+        GatewayTableState* state;
+        int add(const uint8_t* mac);
+};
@@ -0,0 +1,51 @@
+#include "JobGraph.h"
+
+JobGraph::JobGraph() {
+  count = 0;
+}
+
+int JobGraph::add(const char* name, uint32_t dependencies, JobFunction run, void* context, uint32_t stackSize) {
+  if (count >= JOB_GRAPH_MAX_JOBS) return -1;
+  if (dependencies & ~getAllBits()) return -1; //unknown or later job
+  Job& job = jobs[count];
+  job.name = name;
+  job.dependencies = dependencies;
+  job.run = run;
+  job.context = context;
+  job.stackSize = stackSize;
+  return count++;
+}
+
+void JobGraph::runSerial() {
+  for (int i = 0; i < count; i++) {
+    if (jobs[i].run != NULL) jobs[i].run(jobs[i].context);
+  }
+}
+
+uint32_t JobGraph::criticalPath(const uint32_t* durations, uint32_t* finishTimes, uint32_t* pathMask) const {
+  int previous[JOB_GRAPH_MAX_JOBS];
+  int last = -1;
+  uint32_t length = 0;
+  for (int i = 0; i < count; i++) {
+    uint32_t start = 0;
+    previous[i] = -1;
+    for (int j = 0; j < i; j++) {
+      if ((jobs[i].dependencies & JOB_BIT(j)) && finishTimes[j] > start) {
+        start = finishTimes[j];
+        previous[i] = j;
+      }
+    }
+    finishTimes[i] = start + durations[i];
+    if (last < 0 || finishTimes[i] > length) {
+      length = finishTimes[i];
+      last = i;
+    }
+  }
+  if (pathMask != NULL) {
+    *pathMask = 0;
+    for (int i = last; i >= 0; i = previous[i]) {
+      *pathMask |= JOB_BIT(i);
+    }
+  }
+  return length;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define JOB_GRAPH_MAX_JOBS      16  //one event group bit per job
+#define JOB_DEFAULT_STACK       4096
+#define JOB_BIT(job)            (1UL << (job))
+
+// Jobs of one wake cycle and the jobs each one waits for. A job may only depend on
+// jobs added before it, so the graph is acyclic and the insertion order is a valid
+// serial order. Running it is platform specific (see Esp32JobRunner), the timing
+// analysis is not, so the same graph can be studied on a host.
+
+typedef void (*JobFunction)(void* context);
+
+typedef struct {
+  const char* name;
+  uint32_t dependencies;  //JOB_BIT() of every job that must finish first
+  JobFunction run;
+  void* context;
+  uint32_t stackSize;
+} Job;
+
+class JobGraph {
+    public:
+        JobGraph();
+        int add(const char* name, uint32_t dependencies, JobFunction run, void* context = NULL, uint32_t stackSize = JOB_DEFAULT_STACK); //job index, -1 when rejected
+        void runSerial();
+        // Length of the longest dependency chain given the duration of every job; the
+        // shortest possible run with unlimited parallelism. pathMask gets the jobs on it.
+        uint32_t criticalPath(const uint32_t* durations, uint32_t* finishTimes, uint32_t* pathMask) const;
+        int getCount() const { return count; };
+        const Job& get(int index) const { return jobs[index]; };
+        uint32_t getAllBits() const { return count == 32 ? UINT32_MAX : JOB_BIT(count) - 1; };
+    private:
+        Job jobs[JOB_GRAPH_MAX_JOBS];
+        int count;
+};
@@ -0,0 +1,40 @@
+#include "LevelLadder.h"
+
+LevelLadder::LevelLadder(const uint8_t* pins, uint8_t count, uint8_t wetLevel, uint8_t probesBelowSwitch) {
+  this->count = count > LEVEL_LADDER_MAX_PROBES ? LEVEL_LADDER_MAX_PROBES : count;
+  this->wetLevel = wetLevel ? 1 : 0;
+  this->probesBelowSwitch = probesBelowSwitch > this->count ? this->count : probesBelowSwitch;
+  this->pinMask = 0;
+  for (uint8_t i = 0; i < this->count; i++) {
+    this->pins[i] = pins[i];
+    this->pinMask |= 1ULL << pins[i];
+  }
+}
+
+LadderReading LevelLadder::decode(uint64_t gpioSnapshot, bool switchWet) {
+  LadderReading reading;
+  reading.wetMask = 0;
+  reading.fault = false;
+  if (count == 0) {
+    reading.percent = LEVEL_PERCENT_UNKNOWN;
+    return reading;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t level = (gpioSnapshot >> pins[i]) & 1;
+    if (level == wetLevel) reading.wetMask |= 1 << i;
+  }
+  uint8_t wetRun = 0;
+  while (wetRun < count && (reading.wetMask & (1 << wetRun))) {
+    wetRun++;
+  }
+  reading.fault = (reading.wetMask >> wetRun) != 0;
+  if (probesBelowSwitch > 0) {
+    if (switchWet) {
+      reading.fault |= wetRun < probesBelowSwitch;
+    } else {
+      reading.fault |= (reading.wetMask >> probesBelowSwitch) != 0;
+    }
+  }
+  reading.percent = (uint8_t)(wetRun * 100 / count);
+  return reading;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+
+#define LEVEL_LADDER_MAX_PROBES   8
+#define LEVEL_PERCENT_UNKNOWN     0xFF //no ladder configured
+
+// Decodes a ladder of level probes, listed from the bottom of the tank to the top,
+// out of one snapshot of the GPIO input registers (bit n = GPIO n). Water covers the
+// probes from the bottom up, so the wet probes must form a contiguous run starting at
+// the lowest one; any other pattern is reported as a fault and the level falls back
+// to that run, the lowest level the probes can vouch for.
+// When the float switch sits between two probes, the ladder is also checked against it:
+// every probe below the switch is wet while the switch is, and none above it while it
+// is dry. A ladder contradicting the switch (probes unplugged, a shorted probe) is a fault.
+
+typedef struct {
+  uint8_t percent;      //LEVEL_PERCENT_UNKNOWN when no probe is configured
+  uint8_t wetMask;      //bit i = probe i is wet
+  bool fault;           //a probe is wet above a dry one, or the ladder contradicts the float switch
+} LadderReading;
+
+class LevelLadder {
+    public:
+        LevelLadder(const uint8_t* pins, uint8_t count, uint8_t wetLevel, uint8_t probesBelowSwitch = 0);
+        LadderReading decode(uint64_t gpioSnapshot, bool switchWet);
+        uint64_t getPinMask() { return pinMask; }; //every probe pin, for pin setup and wake sources
+        uint8_t getCount() { return count; };
+    private:
+        uint8_t pins[LEVEL_LADDER_MAX_PROBES];
+        uint8_t count;
+        uint8_t wetLevel;   //pin level read when the probe is in water
+        uint8_t probesBelowSwitch; //0 = switch position unknown, not checked
+        uint64_t pinMask;
+};
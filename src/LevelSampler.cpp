@@ -0,0 +1,57 @@
+#include "LevelSampler.h"
+
+LevelSampler::LevelSampler(LevelSamplerState* state, const LevelSamplerPlatform& platform, const LevelSamplerConfig& config) {
+  this->state = state;
+  this->platform = platform;
+  this->config = config;
+  if (this->config.samples == 0) this->config.samples = 1;
+  if (this->config.samples > LEVEL_SAMPLER_MAX_SAMPLES) this->config.samples = LEVEL_SAMPLER_MAX_SAMPLES;
+  if (this->config.confirmWakes == 0) this->config.confirmWakes = 1;
+}
+
+uint8_t LevelSampler::sampleBurst() {
+  uint8_t highVotes = 0;
+  for (uint8_t i = 0; i < config.samples; i++) {
+    if (i > 0) platform.delayUs(config.intervalUs, platform.context);
+    if (platform.read(platform.context)) highVotes++;
+  }
+  return highVotes;
+}
+
+uint8_t LevelSampler::vote(uint8_t highVotes) {
+  uint8_t lowVotes = config.samples - highVotes;
+  if (!state->valid) {
+    return highVotes > lowVotes ? 1 : 0; //nothing to hold on to yet, plain majority
+  }
+  uint8_t current = state->confirmedLevel;
+  uint8_t opposingVotes = current ? lowVotes : highVotes;
+  uint8_t supportingVotes = config.samples - opposingVotes;
+  return opposingVotes >= supportingVotes + 1 + config.hysteresis ? !current : current;
+}
+
+uint8_t LevelSampler::update() {
+  lastHighVotes = sampleBurst();
+  lastBurstLevel = vote(lastHighVotes);
+
+  if (!state->valid) {
+    state->valid = true;
+    state->confirmedLevel = lastBurstLevel;
+    state->candidateWakes = 0;
+    return state->confirmedLevel;
+  }
+
+  if (lastBurstLevel == state->confirmedLevel) {
+    state->candidateWakes = 0; //the change did not last
+  } else {
+    if (state->candidateWakes == 0 || state->candidateLevel != lastBurstLevel) {
+      state->candidateLevel = lastBurstLevel;
+      state->candidateWakes = 0;
+    }
+    state->candidateWakes++;
+    if (state->candidateWakes >= config.confirmWakes) {
+      state->confirmedLevel = lastBurstLevel;
+      state->candidateWakes = 0;
+    }
+  }
+  return state->confirmedLevel;
+}
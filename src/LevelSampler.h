@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+
+// Debounced reading of the float switch. Every update() takes a burst of samples,
+// a majority vote decides the burst level, and leaving the confirmed level needs
+// hysteresis extra votes on top of the majority. A new level is confirmed only after
+// confirmWakes consecutive bursts agree on it, so ripples on the surface do not flip
+// the reported level. State lives in a caller provided struct, normally kept in RTC memory.
+// Pin access is injected, so the sampler runs on a host with scripted traces.
+
+typedef struct {
+  bool valid;               //false until the first burst settles the level
+  uint8_t confirmedLevel;
+  uint8_t candidateLevel;
+  uint8_t candidateWakes;   //consecutive bursts that voted for candidateLevel
+} LevelSamplerState;
+
+typedef struct {
+  int (*read)(void* context);                     //current pin level, 0 or 1
+  void (*delayUs)(uint32_t us, void* context);    //wait between two samples
+  void* context;
+} LevelSamplerPlatform;
+
+typedef struct {
+  uint8_t samples;          //reads per burst, at most LEVEL_SAMPLER_MAX_SAMPLES
+  uint32_t intervalUs;      //time between two reads of a burst
+  uint8_t hysteresis;       //votes needed above the majority to leave the confirmed level
+  uint8_t confirmWakes;     //consecutive bursts needed to confirm a new level
+} LevelSamplerConfig;
+
+#define LEVEL_SAMPLER_MAX_SAMPLES  64
+
+class LevelSampler {
+    public:
+        LevelSampler(LevelSamplerState* state, const LevelSamplerPlatform& platform, const LevelSamplerConfig& config);
+        uint8_t update(); //takes a burst and returns the confirmed level
+        uint8_t getConfirmedLevel() { return state->confirmedLevel; };
+        uint8_t getLastBurstLevel() { return lastBurstLevel; };
+        uint8_t getLastHighVotes() { return lastHighVotes; };
+        bool isPending() { return state->valid && state->candidateWakes > 0; }; //a different level was seen but is not confirmed yet
+    private:
+        LevelSamplerState* state;
+        LevelSamplerPlatform platform;
+        LevelSamplerConfig config;
+        uint8_t lastBurstLevel = 0;
+        uint8_t lastHighVotes = 0;
+        uint8_t sampleBurst();
+        uint8_t vote(uint8_t highVotes);
+};
@@ -0,0 +1,67 @@
+#include "LittleFsSegmentStorage.h"
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <stdlib.h>
+
+static void segmentPath(uint32_t segment, char* path, size_t length, void* context) {
+  snprintf(path, length, "%s/%lu", (const char*)context, (unsigned long)segment);
+}
+
+static bool appendSegment(uint32_t segment, const uint8_t* data, size_t length, void* context) {
+  char path[32];
+  segmentPath(segment, path, sizeof(path), context);
+  File file = LittleFS.open(path, FILE_APPEND, true); //creates the directory too
+  if (!file) return false;
+  size_t written = file.write(data, length);
+  file.close();
+  return written == length;
+}
+
+static int readSegment(uint32_t segment, uint32_t offset, uint8_t* buffer, size_t length, void* context) {
+  char path[32];
+  segmentPath(segment, path, sizeof(path), context);
+  if (!LittleFS.exists(path)) return -1;
+  File file = LittleFS.open(path, FILE_READ);
+  if (!file) return -1;
+  int count = 0;
+  if (file.seek(offset)) {
+    count = file.read(buffer, length);
+  }
+  file.close();
+  return count;
+}
+
+static int32_t segmentSize(uint32_t segment, void* context) {
+  char path[32];
+  segmentPath(segment, path, sizeof(path), context);
+  if (!LittleFS.exists(path)) return -1;
+  File file = LittleFS.open(path, FILE_READ);
+  if (!file) return -1;
+  int32_t bytes = file.size();
+  file.close();
+  return bytes;
+}
+
+static void removeSegment(uint32_t segment, void* context) {
+  char path[32];
+  segmentPath(segment, path, sizeof(path), context);
+  LittleFS.remove(path);
+}
+
+static int listSegments(uint32_t* segments, int max, void* context) {
+  File dir = LittleFS.open((const char*)context);
+  if (!dir || !dir.isDirectory()) return 0;
+  int count = 0;
+  for (File file = dir.openNextFile(); file && count < max; file = dir.openNextFile()) {
+    char* end;
+    unsigned long segment = strtoul(file.name(), &end, 10);
+    if (*end == '\0' && !file.isDirectory()) segments[count++] = segment;
+    file.close();
+  }
+  dir.close();
+  return count;
+}
+
+SegmentStorage littleFsSegmentStorage(const char* directory) {
+  return { appendSegment, readSegment, segmentSize, removeSegment, listSegments, (void*)directory };
+}
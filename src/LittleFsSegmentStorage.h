@@ -0,0 +1,6 @@
+#pragma once
+#include "SegmentStorage.h"
+
+// SegmentStorage on LittleFS, one file per segment named after its number inside
+// directory. LittleFS must already be mounted, PersistentLog does it at startup.
+SegmentStorage littleFsSegmentStorage(const char* directory);
@@ -0,0 +1,85 @@
+#include "LogExporter.h"
+#include <string.h>
+#include <LogCompression.h>
+
+LogExporter::LogExporter(LogExportState* state, const LogSource& source) {
+  this->state = state;
+  this->source = source;
+  sending = false;
+  sendCursor = 0;
+  exhausted = false;
+}
+
+void LogExporter::start(uint32_t from, uint32_t to) {
+  if (from >= to) return;
+  for (int i = 0; i < state->count; i++) {
+    LogExportRange& range = state->ranges[i];
+    //a request behind the cursor of the running range wants delivered chunks again, it waits in its own range
+    bool mergeable = from <= range.end && to >= range.cursor && (i > 0 || from >= range.cursor);
+    if (!mergeable) continue;
+    if (from < range.cursor) range.cursor = from;
+    if (to > range.end) range.end = to;
+    return;
+  }
+  if (state->count < LOG_EXPORT_MAX_RANGES) {
+    state->ranges[state->count].cursor = from;
+    state->ranges[state->count].end = to;
+    state->count++;
+    return;
+  }
+  //queue full, the last range grows to cover the request
+  LogExportRange& last = state->ranges[state->count - 1];
+  if (from < last.cursor) last.cursor = from;
+  if (to > last.end) last.end = to;
+}
+
+bool LogExporter::nextFrame(FrameEncoder& frame) {
+  if (state->count == 0 || exhausted) return false;
+  if (!sending) {
+    sendCursor = state->ranges[0].cursor;
+    sending = true;
+  }
+  uint8_t records[WIRE_LOG_INFLATED_MAX_LEN];
+  uint8_t compressed[LOG_EXPORT_RECORDS_LEN];
+  uint32_t from = sendCursor;
+  size_t capacity = sizeof(records);
+  while (true) {
+    uint32_t to = from;
+    size_t length = source.read(to, state->ranges[0].end, records, capacity, source.context);
+    if (length == 0) {
+      exhausted = true;
+      return false;
+    }
+    int packed = lzCompress(records, length, compressed, sizeof(compressed));
+    bool pays = packed > 0 && (size_t)packed < length;
+    if (pays || length <= LOG_EXPORT_RECORDS_LEN) {
+      uint8_t range[WIRE_LOG_RANGE_LEN];
+      wireWriteU32(range, from);
+      wireWriteU32(&range[4], to);
+      frame.begin(LOG_CHUNK, pays ? WIRE_FLAG_COMPRESSED : 0);
+      frame.putBytes(FIELD_LOG_RANGE, range, sizeof(range));
+      frame.putBytes(FIELD_LOG_RECORDS, pays ? compressed : records, pays ? packed : length);
+      sendCursor = to;
+      return true;
+    }
+    //too many records to fit once compressed, fewer next time down to what fits plain
+    capacity = length * 3 / 4 > LOG_EXPORT_RECORDS_LEN ? length * 3 / 4 : LOG_EXPORT_RECORDS_LEN;
+  }
+}
+
+void LogExporter::commit() {
+  if (!sending) return;
+  state->ranges[0].cursor = sendCursor;
+  if (exhausted) {
+    //range done, the next queued one starts with the following frames
+    state->count--;
+    memmove(&state->ranges[0], &state->ranges[1], state->count * sizeof(LogExportRange));
+  }
+  sending = false;
+  exhausted = false;
+}
+
+void LogExporter::rewind() {
+  sending = false;
+  exhausted = false;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <WireFormat.h>
+
+#define LOG_EXPORT_RECORDS_LEN  (WIRE_MAX_FRAME_LEN - WIRE_HEADER_LEN - 2 * WIRE_FIELD_HEADER_LEN - WIRE_LOG_RANGE_LEN - WIRE_FRAME_SEQUENCE_LEN) //above LOG_TOKEN_MAX_RECORD_LEN
+
+// Streams a range of the flash log as LOG_CHUNK frames, reading one frame worth of
+// records at a time so the log never has to fit in RAM. The cursor is a log address
+// (see LogStore) kept in caller provided state, normally in RTC memory: an export
+// runs over as many wake cycles as it needs, and frames only count as sent once
+// commit() confirms their delivery. After rewind() they are built again.
+// A request arriving during an export, typically for a gap the gateway found, is
+// queued behind the running range, which resumes where it stood once the queue is
+// served in order. Overlapping requests are merged.
+// Records are compressed when that pays off: a frame then carries as many of them as
+// still fit once compressed, up to WIRE_LOG_INFLATED_MAX_LEN bytes.
+
+#define LOG_EXPORT_MAX_RANGES   4 //ranges waiting at once, a further request is merged into the last one
+
+typedef struct {
+  uint32_t cursor;  //log address of the first record not yet delivered
+  uint32_t end;     //log address the range stops at
+} LogExportRange;
+
+typedef struct {
+  uint8_t count;    //queued ranges, the first one is being exported
+  LogExportRange ranges[LOG_EXPORT_MAX_RANGES];
+} LogExportState;
+
+// Reads whole tokenized records from address on, see LogStore::read
+struct LogSource {
+  size_t (*read)(uint32_t& address, uint32_t limit, uint8_t* out, size_t capacity, void* context);
+  void* context;
+};
+
+class LogExporter {
+    public:
+        LogExporter(LogExportState* state, const LogSource& source);
+        void start(uint32_t from, uint32_t to); //records written later than to are left for another export
+        bool isActive() const { return state->count > 0; };
+        uint32_t getCursor() const { return state->count > 0 ? state->ranges[0].cursor : 0; };
+        uint8_t getQueued() const { return state->count; };
+        bool nextFrame(FrameEncoder& frame); //false once the range is exhausted
+        void commit();  //frames built since the last commit or rewind were delivered
+        void rewind();  //they were not, the next frames start at the cursor again
+    private:
+        LogExportState* state;
+        LogSource source;
+        bool sending;
+        uint32_t sendCursor;
+        bool exhausted;
+};
@@ -0,0 +1,234 @@
+#include "LogStore.h"
+#include "Crc16.h"
+#include <string.h>
+
+#define LOG_SCAN_CHUNK_LEN  512 //bytes read at once while scanning a segment
+
+static void writeU16(uint8_t* p, uint16_t value) {
+  p[0] = value;
+  p[1] = value >> 8;
+}
+
+static void writeU32(uint8_t* p, uint32_t value) {
+  p[0] = value;
+  p[1] = value >> 8;
+  p[2] = value >> 16;
+  p[3] = value >> 24;
+}
+
+static uint16_t readU16(const uint8_t* p) {
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t readU32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+LogStore::LogStore(LogStoreState* state, const SegmentStorage& storage, const LogStoreConfig& config) {
+  this->state = state;
+  this->storage = storage;
+  this->config = config;
+  if (this->config.maxSegments < 2) this->config.maxSegments = 2;
+}
+
+bool LogStore::validHeader(const uint8_t* header) {
+  return readU32(header) == LOG_SEGMENT_MAGIC && readU16(&header[8]) == crc16(header, 8);
+}
+
+size_t LogStore::frame(uint8_t* out, const uint8_t* record, size_t length) {
+  if (length == 0 || length > LOG_STORE_MAX_RECORD) return 0;
+  out[0] = (uint8_t)length;
+  writeU16(&out[1], crc16(record, length));
+  memmove(&out[LOG_RECORD_FRAME_LEN], record, length);
+  return LOG_RECORD_FRAME_LEN + length;
+}
+
+// Framed length of the valid record at the start of data, 0 when it is damaged or incomplete
+static size_t parseRecord(const uint8_t* data, size_t length) {
+  if (length < LOG_RECORD_FRAME_LEN) return 0;
+  size_t recordLength = data[0];
+  if (recordLength == 0 || LOG_RECORD_FRAME_LEN + recordLength > length) return 0;
+  if (readU16(&data[1]) != crc16(&data[LOG_RECORD_FRAME_LEN], recordLength)) return 0;
+  return LOG_RECORD_FRAME_LEN + recordLength;
+}
+
+// Valid framed records at the start of data, stops at the first damaged or incomplete one
+static size_t parseRecords(const uint8_t* data, size_t length, LogRecordCallback callback, void* context) {
+  size_t offset = 0;
+  size_t framed;
+  while ((framed = parseRecord(&data[offset], length - offset)) > 0) {
+    if (callback != NULL) callback(&data[offset + LOG_RECORD_FRAME_LEN], framed - LOG_RECORD_FRAME_LEN, context);
+    offset += framed;
+  }
+  return offset;
+}
+
+int LogStore::parseSegment(const uint8_t* data, size_t length, LogRecordCallback callback, void* context) {
+  if (length < LOG_SEGMENT_HEADER_LEN || !validHeader(data)) return -1;
+  return parseRecords(&data[LOG_SEGMENT_HEADER_LEN], length - LOG_SEGMENT_HEADER_LEN, callback, context);
+}
+
+// Records of a stored segment, returns the size up to the last valid record
+uint32_t LogStore::scan(uint32_t segment, LogRecordCallback callback, void* context, bool& intact) {
+  uint8_t chunk[LOG_SCAN_CHUNK_LEN];
+  intact = false;
+  int32_t size = storage.size(segment, storage.context);
+  if (size < LOG_SEGMENT_HEADER_LEN) return 0;
+  if (storage.read(segment, 0, chunk, LOG_SEGMENT_HEADER_LEN, storage.context) != LOG_SEGMENT_HEADER_LEN || !validHeader(chunk)) return 0;
+  uint32_t offset = LOG_SEGMENT_HEADER_LEN;
+  while (offset < (uint32_t)size) {
+    int length = storage.read(segment, offset, chunk, sizeof(chunk), storage.context);
+    if (length <= 0) return offset;
+    //a record cut by the chunk end is read again with the next chunk, chunks hold the largest record
+    size_t used = parseRecords(chunk, length, callback, context);
+    if (used == 0) return offset;
+    offset += used;
+  }
+  intact = offset == (uint32_t)size;
+  return offset;
+}
+
+void LogStore::begin() {
+  if (state->valid) return;
+  uint32_t segments[LOG_STORE_MAX_LIST];
+  int count = storage.list(segments, LOG_STORE_MAX_LIST, storage.context);
+  state->empty = count == 0;
+  state->oldest = 0;
+  state->newest = 0;
+  state->newestSize = 0;
+  for (int i = 0; i < count; i++) {
+    if (i == 0 || segments[i] < state->oldest) state->oldest = segments[i];
+    if (i == 0 || segments[i] > state->newest) state->newest = segments[i];
+  }
+  if (!state->empty) {
+    bool intact;
+    uint32_t size = scan(state->newest, NULL, NULL, intact);
+    //nothing is ever written after a damaged tail, the segment is closed instead
+    state->newestSize = intact ? size : config.segmentBytes;
+  }
+  state->valid = true;
+}
+
+bool LogStore::append(const uint8_t* framed, size_t length) {
+  begin();
+  if (length == 0 || LOG_SEGMENT_HEADER_LEN + length > config.segmentBytes) return false;
+  if (state->empty || state->newestSize + length > config.segmentBytes) {
+    uint32_t segment = state->empty ? state->oldest : state->newest + 1;
+    uint8_t header[LOG_SEGMENT_HEADER_LEN];
+    writeU32(header, LOG_SEGMENT_MAGIC);
+    writeU32(&header[4], segment);
+    writeU16(&header[8], crc16(header, 8));
+    storage.remove(segment, storage.context); //leftover of an older run
+    if (!storage.append(segment, header, sizeof(header), storage.context)) return false;
+    state->newest = segment;
+    state->newestSize = sizeof(header);
+    state->empty = false;
+    while (state->newest - state->oldest >= config.maxSegments) {
+      storage.remove(state->oldest, storage.context);
+      state->oldest++;
+    }
+  }
+  if (!storage.append(state->newest, framed, length, storage.context)) {
+    state->newestSize = config.segmentBytes; //may be partly written, the next batch starts a new segment
+    return false;
+  }
+  state->newestSize += length;
+  return true;
+}
+
+uint32_t LogStore::forEach(LogRecordCallback callback, void* context) {
+  begin();
+  uint32_t damaged = 0;
+  if (state->empty) return 0;
+  for (uint32_t segment = state->oldest; segment <= state->newest; segment++) {
+    bool intact;
+    scan(segment, callback, context, intact);
+    if (!intact && storage.size(segment, storage.context) >= 0) damaged++;
+  }
+  return damaged;
+}
+
+void LogStore::clear() {
+  begin();
+  if (!state->empty) {
+    for (uint32_t segment = state->oldest; segment <= state->newest; segment++) {
+      storage.remove(segment, storage.context);
+    }
+  }
+  state->empty = true;
+  state->oldest = state->newest + 1;
+  state->newest = state->oldest;
+  state->newestSize = 0;
+}
+
+uint32_t LogStore::getStart() {
+  begin();
+  return state->oldest * config.segmentBytes + LOG_SEGMENT_HEADER_LEN;
+}
+
+uint32_t LogStore::getEnd() {
+  begin();
+  if (state->empty) return getStart();
+  return state->newest * config.segmentBytes + (state->newestSize < config.segmentBytes ? state->newestSize : config.segmentBytes);
+}
+
+// First record boundary at or after offset, segmentBytes when damaged records come first
+uint32_t LogStore::nextRecord(uint32_t segment, uint32_t offset) {
+  uint8_t chunk[LOG_SCAN_CHUNK_LEN];
+  uint32_t position = LOG_SEGMENT_HEADER_LEN;
+  while (position < offset) {
+    int length = storage.read(segment, position, chunk, sizeof(chunk), storage.context);
+    size_t used = 0;
+    size_t framed;
+    while (used < (size_t)(length > 0 ? length : 0) && position + used < offset
+        && (framed = parseRecord(&chunk[used], length - used)) > 0) {
+      used += framed;
+    }
+    if (used == 0) return config.segmentBytes;
+    position += used;
+  }
+  return position;
+}
+
+size_t LogStore::read(uint32_t& address, uint32_t limit, uint8_t* out, size_t capacity) {
+  begin();
+  if (address < getStart()) address = getStart(); //recycled meanwhile
+  uint8_t chunk[LOG_SCAN_CHUNK_LEN];
+  size_t used = 0;
+  while (!state->empty && address < limit) {
+    uint32_t segment = address / config.segmentBytes;
+    uint32_t offset = address % config.segmentBytes;
+    if (segment > state->newest) break;
+    if (offset < LOG_SEGMENT_HEADER_LEN) {
+      address = segment * config.segmentBytes + LOG_SEGMENT_HEADER_LEN;
+      continue;
+    }
+    if (segment == state->newest && offset >= state->newestSize) break;
+    int length = storage.read(segment, offset, chunk, sizeof(chunk), storage.context);
+    size_t position = 0;
+    size_t framed;
+    while (position < (size_t)(length > 0 ? length : 0) && address + position < limit
+        && (framed = parseRecord(&chunk[position], length - position)) > 0) {
+      size_t recordLength = framed - LOG_RECORD_FRAME_LEN;
+      if (used + recordLength > capacity) {
+        address += position;
+        return used;
+      }
+      memcpy(&out[used], &chunk[position + LOG_RECORD_FRAME_LEN], recordLength);
+      used += recordLength;
+      position += framed;
+    }
+    if (position == 0) {
+      //a requested address may fall inside a record, otherwise this is the end or a damaged tail
+      uint32_t boundary = nextRecord(segment, offset);
+      if (boundary > offset && boundary < config.segmentBytes) {
+        address = segment * config.segmentBytes + boundary;
+      } else {
+        address = (segment + 1) * config.segmentBytes + LOG_SEGMENT_HEADER_LEN;
+      }
+    } else {
+      address += position;
+    }
+  }
+  return used;
+}
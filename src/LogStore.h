@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "SegmentStorage.h"
+
+#define LOG_SEGMENT_MAGIC         0x474C5331 //"1SLG" little-endian
+#define LOG_SEGMENT_HEADER_LEN    10  //magic u32, sequence u32, CRC-16 of both
+#define LOG_RECORD_FRAME_LEN      3   //length u8, CRC-16 of the record
+#define LOG_STORE_MAX_LIST        32  //segments looked at when the state is rebuilt
+#define LOG_STORE_MAX_RECORD      255
+
+// Circular log on numbered segment files. Each segment starts with a header holding
+// its sequence number, then framed records with a CRC each. Records are only ever
+// appended: when a batch does not fit the newest segment a new one is started, and
+// beyond maxSegments the oldest is deleted, so appending never fails for lack of
+// space and every segment is erased as often as the others.
+//
+// The position of the newest segment lives in a caller provided struct, normally in
+// RTC memory. After a power loss it is rebuilt from a directory listing and a scan
+// of the newest segment only; a segment with a damaged tail is closed and the next
+// append starts a new one.
+
+typedef struct {
+  uint32_t segmentBytes;
+  uint8_t maxSegments;
+} LogStoreConfig;
+
+typedef struct {
+  bool valid;
+  bool empty;             //no segment yet
+  uint32_t oldest;
+  uint32_t newest;
+  uint32_t newestSize;    //bytes, segmentBytes when the segment must not be appended to
+} LogStoreState;
+
+typedef void (*LogRecordCallback)(const uint8_t* record, size_t length, void* context);
+
+class LogStore {
+    public:
+        LogStore(LogStoreState* state, const SegmentStorage& storage, const LogStoreConfig& config);
+        void begin(); //rebuilds the state from the segments when RTC memory was lost
+        // Frames one record into out, which needs LOG_RECORD_FRAME_LEN more bytes than the record.
+        static size_t frame(uint8_t* out, const uint8_t* record, size_t length);
+        bool append(const uint8_t* framed, size_t length); //whole framed records, at most a segment minus its header
+        uint32_t forEach(LogRecordCallback callback, void* context); //records oldest first, returns the damaged segments
+        void clear();
+        // Log addresses (segment * segmentBytes + offset in the segment) only grow, so they make
+        // cursors that stay valid across deep sleep and power loss.
+        uint32_t getStart(); //address of the oldest stored record
+        uint32_t getEnd();   //address after the newest record
+        // Copies whole records, without their frames, from address on until limit or capacity is reached,
+        // and moves address past them. Recycled and damaged parts are skipped, 0 when nothing is left.
+        size_t read(uint32_t& address, uint32_t limit, uint8_t* out, size_t capacity);
+        // Records of a segment image, e.g. a file copied off the flash. Returns the bytes of valid
+        // records after the header, -1 when data does not start with a segment header.
+        static int parseSegment(const uint8_t* data, size_t length, LogRecordCallback callback, void* context);
+    private:
+        LogStoreState* state;
+        SegmentStorage storage;
+        LogStoreConfig config;
+        uint32_t scan(uint32_t segment, LogRecordCallback callback, void* context, bool& intact);
+        uint32_t nextRecord(uint32_t segment, uint32_t offset);
+        static bool validHeader(const uint8_t* header);
+};
@@ -0,0 +1,41 @@
+#include "MemorySegmentStorage.h"
+#include <string.h>
+
+static bool appendSegment(uint32_t segment, const uint8_t* data, size_t length, void* context) {
+  std::vector<uint8_t>& bytes = (*(MemorySegments*)context)[segment];
+  bytes.insert(bytes.end(), data, data + length);
+  return true;
+}
+
+static int readSegment(uint32_t segment, uint32_t offset, uint8_t* buffer, size_t length, void* context) {
+  MemorySegments& segments = *(MemorySegments*)context;
+  MemorySegments::const_iterator found = segments.find(segment);
+  if (found == segments.end()) return -1;
+  if (offset >= found->second.size()) return 0;
+  size_t count = found->second.size() - offset < length ? found->second.size() - offset : length;
+  memcpy(buffer, &found->second[offset], count);
+  return (int)count;
+}
+
+static int32_t segmentSize(uint32_t segment, void* context) {
+  MemorySegments& segments = *(MemorySegments*)context;
+  MemorySegments::const_iterator found = segments.find(segment);
+  return found == segments.end() ? -1 : (int32_t)found->second.size();
+}
+
+static void removeSegment(uint32_t segment, void* context) {
+  ((MemorySegments*)context)->erase(segment);
+}
+
+static int listSegments(uint32_t* segments, int max, void* context) {
+  int count = 0;
+  const MemorySegments& stored = *(MemorySegments*)context;
+  for (MemorySegments::const_iterator it = stored.begin(); it != stored.end() && count < max; ++it) {
+    segments[count++] = it->first;
+  }
+  return count;
+}
+
+SegmentStorage memorySegmentStorage(MemorySegments* segments) {
+  return { appendSegment, readSegment, segmentSize, removeSegment, listSegments, segments };
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <map>
+#include <vector>
+#include "SegmentStorage.h"
+
+// SegmentStorage in RAM for host tests of the flash backed stores. Segments are plain
+// byte vectors, so a test can cut or corrupt them the way a power loss or a worn flash
+// page would.
+typedef std::map<uint32_t, std::vector<uint8_t> > MemorySegments;
+SegmentStorage memorySegmentStorage(MemorySegments* segments);
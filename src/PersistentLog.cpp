@@ -1,13 +1,15 @@
 #include "PersistentLog.h"
-#include <ArduinoJson.h>
 #include "ESPLogMacros.h"
+#include "BootProfiler.h"
+#include "LittleFsSegmentStorage.h"
 #define FORMAT_LITTLEFS_IF_FAILED true
 
-char EMPTY_STRING[1] = "";
-
-PersistentLog::PersistentLog(const char* filePath, int sizeLimit) {
-   this->filePath = filePath;
-   this->sizeLimit = sizeLimit;
+PersistentLog::PersistentLog(LogStoreState* state, const char* directory, int sizeLimit)
+   : store(state, littleFsSegmentStorage(directory), { LOG_SEGMENT_BYTES, (uint8_t)(sizeLimit / LOG_SEGMENT_BYTES) }) {
+   batchLength = 0;
+   writeErrors = 0;
+   writeLock = xSemaphoreCreateMutex();
+   writerTask = NULL;
    Serial.println("Log constructor called");
    init();
 }
@@ -24,97 +26,92 @@ void PersistentLog::LittleFSInit() {
    delay(50);
 }
 
-void PersistentLog::createLogFileIfNotExists(const char* path){
-   if(LittleFS.exists(path)) return;
-   Serial.println("Creating log file");
-   File writeLog = LittleFS.open(path, FILE_WRITE);
-   if(!writeLog) {
-      Serial.println("Log file creation failed");
-      return;
-   }
-   delay(50);
-   writeLog.close();
-   Serial.println("Log file created");
-}
-
-bool PersistentLog::flushHandler(const char *buffer, int n) {
-   int index = 0;
-   // Print a record at a time
-   while (index < n && strlen(&buffer[index]) > 0) {
-      Serial.print("---");
-      int bytePrinted = Serial.print(&buffer[index]);
-      Serial.println("---");
-      // +1, since '\0' is processed
-      index += bytePrinted + 1;
-  }
-  return true;
-}
-
 void PersistentLog::init() {
+   BootProfiler::begin(PHASE_LOG_MOUNT);
    LittleFSInit();
-   logger = new ESPLogger(filePath);
-   // Set the space reserved to the log (in bytes)
-   logger->setSizeLimit(sizeLimit);
-   logger->setFlushCallback(flushCallback);
-   logger->begin();
-   // createLogFileIfNotExists(filePath);
+   BootProfiler::end(PHASE_LOG_MOUNT);
    Serial.println("Persistent log initiated");
 }
 
-void PersistentLog::saveLog(char* msg, int size) {
-   if (!LOG_PERSISTENCE_ACTIVE) return;
-   if(size < 0) return;
-   
-   bool success = logger->append(msg, true);
-   if (success) {
-      Serial.println("Record stored!");
-   } else {
-      if (logger->isFull()) {
-         Serial.println("Record NOT stored! You had filled the available space: flush or reset the "
-                        "log before appending another record");
-      } else {
-         Serial.println("Something goes wrong, record NOT stored!");
-      }
+void PersistentLog::writeBatch() {
+   if (!store.append(batch, batchLength)) {
+      writeErrors++;
    }
+   batchLength = 0;
 }
 
-int PersistentLog::log(const char* format, va_list args) {
-   int ret = vsnprintf(log_print_buffer, sizeof(log_print_buffer), format, args);
-   saveLog(log_print_buffer, ret);
-   return vprintf(format, args);
+/**
+ * Moves records from the ring to flash, a partial batch is only written when partialBatch is set
+*/
+void PersistentLog::drain(bool partialBatch) {
+   xSemaphoreTake(writeLock, portMAX_DELAY);
+   while (true) {
+      size_t length = 0;
+      //a full framed record always fits behind a partial batch, it is popped behind room for its frame
+      while (batchLength < LOG_WRITE_BATCH_LEN
+            && (length = ring.pop(&batch[batchLength + LOG_RECORD_FRAME_LEN], sizeof(batch) - batchLength - LOG_RECORD_FRAME_LEN)) > 0) {
+         batchLength += LogStore::frame(&batch[batchLength], &batch[batchLength + LOG_RECORD_FRAME_LEN], length);
+      }
+      if (batchLength < LOG_WRITE_BATCH_LEN) break;
+      writeBatch();
+   }
+   if (partialBatch && batchLength > 0) {
+      writeBatch();
+   }
+   xSemaphoreGive(writeLock);
 }
 
-char* PersistentLog::readLogFile() {
-   // Serial.printf("readLogFile()");
-   File logFile = LittleFS.open(filePath);
-   if(!logFile){
-      Serial.println("Failed to open log file for reading");
-      return EMPTY_STRING;
+void PersistentLog::writerLoop(void* arg) {
+   PersistentLog* log = (PersistentLog*)arg;
+   while (true) {
+      //woken early when a batch is ready, otherwise whatever is queued goes out on the period
+      bool batchReady = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOG_WRITER_PERIOD_MS)) > 0;
+      log->drain(!batchReady);
    }
+}
 
-   unsigned int fileSize = logFile.size();
-   Serial.printf("Log file size: %d bytes\n", fileSize);
-   //read only last n characters, n is LOG_BUFFER_SIZE
-   int bytesToRead = fileSize > LOG_BUFFER_SIZE ? LOG_BUFFER_SIZE : fileSize;
-   int seekPos = fileSize <= LOG_BUFFER_SIZE ? 0 : fileSize - LOG_BUFFER_SIZE;
-   if (seekPos > 0) {
-      logFile.seek(seekPos);
+void PersistentLog::startWriter() {
+   if (!LOG_PERSISTENCE_ACTIVE || writerTask != NULL) return;
+   xTaskCreate(writerLoop, "log_writer", LOG_WRITER_STACK, this, tskIDLE_PRIORITY + 1, &writerTask);
+}
+
+void PersistentLog::flush() {
+   if (!LOG_PERSISTENCE_ACTIVE) return;
+   drain(true);
+}
+
+int PersistentLog::log(const char* format, va_list args) {
+   if (LOG_PERSISTENCE_ACTIVE) {
+      //the encoder consumes its own copy, args is still needed for the console
+      uint8_t record[LOG_TOKEN_MAX_RECORD_LEN];
+      va_list recordArgs;
+      va_copy(recordArgs, args);
+      size_t length = logTokenEncode(record, time(NULL), format, recordArgs);
+      va_end(recordArgs);
+      ring.push(record, length);
+      if (writerTask != NULL && ring.getUsed() >= LOG_WRITE_BATCH_LEN) {
+         xTaskNotifyGive(writerTask);
+      }
    }
-   logFile.read((uint8_t*)log_read_buffer, bytesToRead);
-   log_read_buffer[bytesToRead - 1] = '\0'; //end of string
+   return vprintf(format, args);
+}
 
-   logFile.close();
-   return log_read_buffer;
+size_t PersistentLog::readRecords(uint32_t& address, uint32_t limit, uint8_t* out, size_t capacity) {
+   xSemaphoreTake(writeLock, portMAX_DELAY);
+   size_t length = store.read(address, limit, out, capacity);
+   xSemaphoreGive(writeLock);
+   return length;
 }
 
-std::string PersistentLog::readLogFileAsJsonPretty() {
-   char* log = readLogFile();
-   StaticJsonDocument<LOG_JSON_BUFFER_SIZE> json_doc;
-   json_doc["content"] = log;
-   int bytesWritten = serializeJsonPretty(json_doc, log_json_buffer);
-   return std::string(log_json_buffer);
+uint32_t PersistentLog::getEnd() {
+   xSemaphoreTake(writeLock, portMAX_DELAY);
+   uint32_t end = store.getEnd();
+   xSemaphoreGive(writeLock);
+   return end;
 }
 
 void PersistentLog::truncateLogFile() {
-   LittleFS.remove(filePath);
-}
\ No newline at end of file
+   xSemaphoreTake(writeLock, portMAX_DELAY);
+   store.clear();
+   xSemaphoreGive(writeLock);
+}
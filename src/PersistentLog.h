@@ -1,32 +1,44 @@
 #include <Arduino.h>
 #include <FS.h>
-using fs::FS; //necessary for ESPLogger to compile
-#include <ESPLogger.h>
+#include <LittleFS.h>
+#include <LogTokens.h>
+#include <LogRing.h>
+#include "LogStore.h"
 
-#define LOG_BUFFER_SIZE 512
-#define LOG_JSON_BUFFER_SIZE 1024
 #define LOG_PERSISTENCE_ACTIVE false
+#define LOG_WRITE_BATCH_LEN     512   //bytes written to flash at once
+#define LOG_WRITER_PERIOD_MS    2000  //a partial batch waits at most this long
+#define LOG_WRITER_STACK        4096
+#define LOG_SEGMENT_BYTES       2048  //sizeLimit is split into segments of this size
 
+// Log records are tokenized (see lib/LogTokens) and queued in a lock-free ring, so a
+// task that logs never waits for flash. A low priority writer task frames them with
+// a CRC and appends them in batches to a LogStore in directory, which drops the
+// oldest segment to stay within sizeLimit. tools/log_decode renders the records with
+// the firmware ELF.
 class PersistentLog {
    public:
-      PersistentLog(const char* filePath = "/log.txt", int sizeLimit = 10240);
+      PersistentLog(LogStoreState* state, const char* directory = "/log", int sizeLimit = 10240);
       ~PersistentLog();
       void init();
-      char* readLogFile();
-      std::string readLogFileAsJsonPretty();
+      size_t readRecords(uint32_t& address, uint32_t limit, uint8_t* out, size_t capacity); //see LogStore::read
+      uint32_t getEnd(); //log address after the newest record on flash
       void truncateLogFile();
       int log(const char* format, va_list args);
-      bool flushHandler(const char *buffer, int n);
-      ESPLogger::CallbackFlush flushCallback;
+      void startWriter();
+      void flush(); //writes every queued record, before deep sleep
+      uint32_t getDropped() { return ring.getDropped(); }; //records lost because the ring was full
+      uint32_t getWriteErrors() { return writeErrors; }; //batches the file system refused
    private:
-      const char* filePath;
-      int sizeLimit; //bytes
+      LogStore store;
       static void LittleFSInit();
-      static void createLogFileIfNotExists(const char* path);
-      void saveLog(char* msg, int size);
-      char log_print_buffer[LOG_BUFFER_SIZE];
-      char log_read_buffer[LOG_BUFFER_SIZE];
-      char log_write_buffer[LOG_BUFFER_SIZE];
-      char log_json_buffer[LOG_JSON_BUFFER_SIZE];
-      ESPLogger *logger;
-};
\ No newline at end of file
+      LogRing ring;
+      uint8_t batch[LOG_WRITE_BATCH_LEN + LOG_RECORD_FRAME_LEN + LOG_TOKEN_MAX_RECORD_LEN]; //framed records, guarded by writeLock
+      size_t batchLength;
+      uint32_t writeErrors;
+      SemaphoreHandle_t writeLock;
+      TaskHandle_t writerTask;
+      void drain(bool partialBatch);
+      void writeBatch();
+      static void writerLoop(void* arg);
+};
@@ -0,0 +1,35 @@
+#include "ReportPolicy.h"
+
+static uint16_t distance(int a, int b) {
+  return a > b ? a - b : b - a;
+}
+
+ReportPolicy::ReportPolicy(ReportState* state, uint16_t voltageDeadbandMv, uint8_t chargeDeadband, uint16_t heartbeatCycles) {
+  this->state = state;
+  this->voltageDeadbandMv = voltageDeadbandMv;
+  this->chargeDeadband = chargeDeadband;
+  this->heartbeatCycles = heartbeatCycles;
+}
+
+ReportDecision ReportPolicy::evaluate(uint8_t waterLevel, uint16_t voltageMv, uint8_t charge) {
+  ReportDecision decision;
+  decision.waterLevelChanged = !state->hasSent || waterLevel != state->lastWaterLevel;
+  decision.voltageChanged = !state->hasSent || distance(voltageMv, state->lastVoltageMv) >= voltageDeadbandMv;
+  decision.chargeChanged = !state->hasSent || distance(charge, state->lastCharge) >= chargeDeadband;
+  decision.heartbeat = state->cyclesSinceSend + 1 >= heartbeatCycles;
+  decision.send = decision.waterLevelChanged || decision.voltageChanged || decision.chargeChanged || decision.heartbeat;
+  return decision;
+}
+
+void ReportPolicy::commit(uint8_t waterLevel, uint16_t voltageMv, uint8_t charge, uint32_t now) {
+  state->hasSent = true;
+  state->lastWaterLevel = waterLevel;
+  state->lastVoltageMv = voltageMv;
+  state->lastCharge = charge;
+  state->cyclesSinceSend = 0;
+  state->lastSendTime = now;
+}
+
+void ReportPolicy::skip() {
+  if (state->cyclesSinceSend < UINT16_MAX) state->cyclesSinceSend++;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+
+// Decides whether the readings of a wake cycle are worth a transmission.
+// Water level changes are always reported, voltage and charge only when they move
+// past their deadband, and everything is sent as a heartbeat every heartbeatCycles.
+// State lives in a caller provided struct, normally kept in RTC memory.
+
+typedef struct {
+  bool hasSent;             //false until the first report, which is always sent
+  uint8_t lastWaterLevel;
+  uint16_t lastVoltageMv;
+  uint8_t lastCharge;
+  uint16_t cyclesSinceSend;
+  uint32_t lastSendTime;    //seconds
+} ReportState;
+
+typedef struct {
+  bool send;
+  bool waterLevelChanged;
+  bool voltageChanged;
+  bool chargeChanged;
+  bool heartbeat;
+} ReportDecision;
+
+class ReportPolicy {
+    public:
+        ReportPolicy(ReportState* state, uint16_t voltageDeadbandMv, uint8_t chargeDeadband, uint16_t heartbeatCycles);
+        ReportDecision evaluate(uint8_t waterLevel, uint16_t voltageMv, uint8_t charge);
+        void commit(uint8_t waterLevel, uint16_t voltageMv, uint8_t charge, uint32_t now); //readings were delivered
+        void skip(); //nothing was delivered this cycle
+        uint16_t getCyclesSinceSend() { return state->cyclesSinceSend; };
+    private:
+        ReportState* state;
+        uint16_t voltageDeadbandMv;
+        uint8_t chargeDeadband;
+        uint16_t heartbeatCycles;
+};
@@ -0,0 +1,60 @@
+#include "SampleAggregator.h"
+#include "ESPLogMacros.h"
+
+SampleAggregator::SampleAggregator(ESPNow* espNow) : frame(frameBuffer, sizeof(frameBuffer)) {
+  this->espNow = espNow;
+  this->lock = xSemaphoreCreateMutex();
+  this->pendingCount = 0;
+  frame.begin(SENSOR_INFO);
+}
+
+SampleAggregator::~SampleAggregator() {
+  vSemaphoreDelete(lock);
+}
+
+void SampleAggregator::addU8(fieldTag tag, uint8_t value) {
+  add(tag, &value, 1);
+}
+
+void SampleAggregator::addU16(fieldTag tag, uint16_t value) {
+  uint8_t bytes[2];
+  wireWriteU16(bytes, value);
+  add(tag, bytes, sizeof(bytes));
+}
+
+void SampleAggregator::add(fieldTag tag, const void* value, size_t length) {
+  xSemaphoreTake(lock, portMAX_DELAY);
+  bool added = frame.putBytes(tag, value, length);
+  if (added) {
+    pendingCount++;
+  }
+  xSemaphoreGive(lock);
+
+  if (!added) {
+    // Reading does not fit in the pending frame, fall back to a frame of its own
+    ESP_LOGW(AGGREGATOR, "Reading with tag %d (%d bytes) does not fit, sending it alone", tag, length);
+    sendAlone(tag, value, length);
+  }
+}
+
+void SampleAggregator::sendAlone(fieldTag tag, const void* value, size_t length) {
+  uint8_t buffer[WIRE_MAX_FRAME_LEN];
+  FrameEncoder singleFrame(buffer, sizeof(buffer));
+  singleFrame.begin(SENSOR_INFO);
+  if (!singleFrame.putBytes(tag, value, length)) {
+    ESP_LOGE(AGGREGATOR, "Reading with tag %d is larger than a frame, dropped", tag);
+    return;
+  }
+  espNow->sendFrame(singleFrame);
+}
+
+void SampleAggregator::flush() {
+  xSemaphoreTake(lock, portMAX_DELAY);
+  if (frame.hasFields()) {
+    ESP_LOGI(AGGREGATOR, "Flushing %d readings in one frame (%d bytes)", pendingCount, frame.length());
+    espNow->sendFrame(frame);
+  }
+  frame.begin(SENSOR_INFO);
+  pendingCount = 0;
+  xSemaphoreGive(lock);
+}
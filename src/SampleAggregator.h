@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+#include <WireFormat.h>
+#include "ESPNow.h"
+
+// Collects every reading produced during a wake cycle into a single SENSOR_INFO frame,
+// so the radio transmits once per cycle instead of once per reading.
+class SampleAggregator {
+    public:
+        SampleAggregator(ESPNow* espNow);
+        ~SampleAggregator();
+        void addU8(fieldTag tag, uint8_t value);
+        void addU16(fieldTag tag, uint16_t value);
+        void add(fieldTag tag, const void* value, size_t length);
+        void flush();
+        int getPendingCount() { return pendingCount; };
+    private:
+        ESPNow* espNow;
+        SemaphoreHandle_t lock;
+        uint8_t frameBuffer[WIRE_MAX_FRAME_LEN];
+        FrameEncoder frame;
+        int pendingCount;
+        void sendAlone(fieldTag tag, const void* value, size_t length);
+};
@@ -0,0 +1,76 @@
+#include "SampleBuffer.h"
+
+SampleBuffer::SampleBuffer(SampleBufferState* state, uint8_t threshold, uint32_t maxLatencyS) {
+  this->state = state;
+  this->threshold = threshold > SAMPLE_BUFFER_CAPACITY ? SAMPLE_BUFFER_CAPACITY : threshold;
+  this->maxLatencyS = maxLatencyS;
+}
+
+void SampleBuffer::push(const BufferedSample& sample) {
+  if (state->head >= SAMPLE_BUFFER_CAPACITY || state->count > SAMPLE_BUFFER_CAPACITY) clear(); //RTC memory garbage
+  state->samples[state->head] = sample;
+  state->head = (state->head + 1) % SAMPLE_BUFFER_CAPACITY;
+  if (state->count < SAMPLE_BUFFER_CAPACITY) {
+    state->count++;
+  } else if (state->dropped < UINT16_MAX) {
+    state->dropped++;
+  }
+}
+
+const BufferedSample& SampleBuffer::oldest() {
+  return get(0);
+}
+
+const BufferedSample& SampleBuffer::get(int index) const {
+  return state->samples[(state->head + SAMPLE_BUFFER_CAPACITY - state->count + index) % SAMPLE_BUFFER_CAPACITY];
+}
+
+FlushReason SampleBuffer::flushReason(uint32_t now, bool urgent) {
+  if (state->count == 0) return FLUSH_NONE;
+  if (urgent) return FLUSH_URGENT;
+  if (state->count >= threshold) return FLUSH_FULL;
+  if (now - oldest().time >= maxLatencyS) return FLUSH_DEADLINE;
+  return FLUSH_NONE;
+}
+
+uint32_t SampleBuffer::secondsUntilDeadline(uint32_t now) {
+  if (state->count == 0) return UINT32_MAX;
+  uint32_t waited = now - oldest().time;
+  return waited >= maxLatencyS ? 0 : maxLatencyS - waited;
+}
+
+static void writeSampleRecord(uint8_t* record, const BufferedSample& sample, uint32_t now) {
+  //ages instead of timestamps, the sensor clock is not set without NTP
+  uint32_t age = sample.time == SAMPLE_TIME_UNKNOWN ? WIRE_AGE_UNKNOWN : (now >= sample.time ? now - sample.time : 0);
+  wireWriteU32(record, age);
+  record[4] = sample.waterLevel;
+  wireWriteU16(&record[5], sample.voltageMv);
+  record[7] = sample.charge;
+  record[8] = sample.fillPercent;
+  record[9] = sample.fillFlags;
+}
+
+bool SampleBuffer::encode(FrameEncoder& frame, uint32_t now) {
+  frame.begin(SENSOR_INFO);
+  if (state->count == 0) return false;
+  uint8_t value[SAMPLE_BUFFER_CAPACITY * WIRE_SAMPLE_RECORD_LEN];
+  for (int i = 0; i < state->count; i++) {
+    writeSampleRecord(&value[i * WIRE_SAMPLE_RECORD_LEN], get(i), now);
+  }
+  return frame.putBytes(FIELD_SAMPLE_BATCH, value, state->count * WIRE_SAMPLE_RECORD_LEN);
+}
+
+bool encodeSampleBatch(FrameEncoder& frame, const BufferedSample* samples, int count, uint32_t now) {
+  frame.begin(SENSOR_INFO);
+  if (count <= 0 || count > SAMPLE_BATCH_MAX_RECORDS) return false;
+  uint8_t value[SAMPLE_BATCH_MAX_RECORDS * WIRE_SAMPLE_RECORD_LEN];
+  for (int i = 0; i < count; i++) {
+    writeSampleRecord(&value[i * WIRE_SAMPLE_RECORD_LEN], samples[i], now);
+  }
+  return frame.putBytes(FIELD_SAMPLE_BATCH, value, count * WIRE_SAMPLE_RECORD_LEN);
+}
+
+void SampleBuffer::clear() {
+  state->head = 0;
+  state->count = 0;
+}
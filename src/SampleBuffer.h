@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include <WireFormat.h>
+
+#define SAMPLE_BUFFER_CAPACITY  22  //one FIELD_SAMPLE_BATCH of WIRE_SAMPLE_RECORD_LEN byte records plus FIELD_TANK_STATS fit a frame
+#define SAMPLE_TIME_UNKNOWN     UINT32_MAX //sampled before the clock restarted, sent with age WIRE_AGE_UNKNOWN
+#define SAMPLE_BATCH_MAX_RECORDS  ((WIRE_MAX_FRAME_LEN - WIRE_HEADER_LEN - WIRE_FIELD_HEADER_LEN) / WIRE_SAMPLE_RECORD_LEN) //FIELD_SAMPLE_BATCH alone in a frame
+
+// Readings taken on wakes without the radio, sent later as one batched frame.
+// The buffer is a ring: when the radio can't deliver for a long time the oldest
+// samples are overwritten. State lives in a caller provided struct, normally kept
+// in RTC memory.
+
+typedef struct {
+  uint32_t time;        //seconds on a clock that does not jump, e.g. the RTC timer, when sampled
+  uint8_t waterLevel;
+  uint16_t voltageMv;
+  uint8_t charge;
+  uint8_t fillPercent;  //WIRE_FILL_UNKNOWN without probe ladder
+  uint8_t fillFlags;    //WIRE_FILL_FLAG_*
+} BufferedSample;
+
+typedef struct {
+  uint8_t head;         //next slot written
+  uint8_t count;
+  uint16_t dropped;     //samples overwritten before they could be sent
+  BufferedSample samples[SAMPLE_BUFFER_CAPACITY];
+} SampleBufferState;
+
+enum FlushReason {
+  FLUSH_NONE,
+  FLUSH_URGENT,         //event that must not wait, e.g. water level change
+  FLUSH_FULL,           //threshold reached
+  FLUSH_DEADLINE        //oldest sample waited maxLatencyS
+};
+
+class SampleBuffer {
+    public:
+        SampleBuffer(SampleBufferState* state, uint8_t threshold, uint32_t maxLatencyS);
+        void push(const BufferedSample& sample);
+        FlushReason flushReason(uint32_t now, bool urgent);
+        uint32_t secondsUntilDeadline(uint32_t now); //UINT32_MAX when empty
+        bool encode(FrameEncoder& frame, uint32_t now); //SENSOR_INFO frame with every buffered sample
+        void clear();
+        const BufferedSample& get(int index) const; //0 is the oldest
+        uint8_t getCount() { return state->count; };
+        uint16_t getDropped() { return state->dropped; };
+    private:
+        SampleBufferState* state;
+        uint8_t threshold;
+        uint32_t maxLatencyS;
+        const BufferedSample& oldest();
+};
+
+// SENSOR_INFO frame with one FIELD_SAMPLE_BATCH of samples, oldest first, at most SAMPLE_BATCH_MAX_RECORDS
+bool encodeSampleBatch(FrameEncoder& frame, const BufferedSample* samples, int count, uint32_t now);
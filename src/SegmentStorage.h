@@ -0,0 +1,14 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Numbered, append-only segment files. Flash backed stores (StoreForwardQueue,
+// LogStore) go through this table so they can run on a Linux host against RAM.
+struct SegmentStorage {
+  bool (*append)(uint32_t segment, const uint8_t* data, size_t length, void* context); //creates the segment
+  int (*read)(uint32_t segment, uint32_t offset, uint8_t* buffer, size_t length, void* context); //bytes read, -1 without segment
+  int32_t (*size)(uint32_t segment, void* context); //-1 without segment
+  void (*remove)(uint32_t segment, void* context);
+  int (*list)(uint32_t* segments, int max, void* context); //numbers of the stored segments, any order
+  void* context;
+};
@@ -0,0 +1,164 @@
+#include "StoreForwardQueue.h"
+#include "Crc16.h"
+
+#define STORE_FORWARD_CHUNK_RECORDS   16 //records written or read with one storage call
+
+StoreForwardQueue::StoreForwardQueue(StoreForwardState* state, const SegmentStorage& storage, const StoreForwardConfig& config) {
+  this->state = state;
+  this->storage = storage;
+  this->config = config;
+  if (this->config.segmentBytes < STORE_FORWARD_RECORD_LEN) this->config.segmentBytes = STORE_FORWARD_RECORD_LEN;
+  if (this->config.maxSegments == 0) this->config.maxSegments = 1;
+}
+
+void StoreForwardQueue::begin() {
+  if (state->valid) return;
+  uint32_t segments[STORE_FORWARD_MAX_LIST];
+  int count = storage.list(segments, STORE_FORWARD_MAX_LIST, storage.context);
+  state->oldest = 0;
+  state->newest = 0;
+  state->readOffset = 0;
+  state->pending = 0;
+  state->dropped = 0;
+  for (int i = 0; i < count; i++) {
+    if (i == 0 || segments[i] < state->oldest) state->oldest = segments[i];
+    if (i == 0 || segments[i] > state->newest) state->newest = segments[i];
+    state->pending += segmentSize(segments[i]) / STORE_FORWARD_RECORD_LEN;
+  }
+  //the RTC clock restarted with the state, stored sample times belong to an older cycle
+  uint16_t newest;
+  state->powerCycle = count > 0 && newestPowerCycle(newest) ? newest + 1 : 0;
+  state->valid = true;
+}
+
+bool StoreForwardQueue::newestPowerCycle(uint16_t& powerCycle) {
+  uint8_t record[STORE_FORWARD_RECORD_LEN];
+  BufferedSample sample;
+  for (uint32_t segment = state->newest; ; segment--) {
+    for (int32_t offset = (int32_t)(segmentSize(segment) / STORE_FORWARD_RECORD_LEN - 1) * STORE_FORWARD_RECORD_LEN;
+        offset >= 0; offset -= STORE_FORWARD_RECORD_LEN) {
+      if (storage.read(segment, offset, record, sizeof(record), storage.context) == sizeof(record)
+          && decodeRecord(record, sample)) {
+        powerCycle = wireReadU16(&record[1]);
+        return true;
+      }
+    }
+    if (segment == state->oldest) return false;
+  }
+}
+
+uint32_t StoreForwardQueue::segmentSize(uint32_t segment) {
+  int32_t size = storage.size(segment, storage.context);
+  return size < 0 ? 0 : (uint32_t)size;
+}
+
+void StoreForwardQueue::rotate() {
+  state->newest++;
+  if (state->newest - state->oldest < config.maxSegments) return;
+  //queue full, the oldest undelivered records make room
+  uint32_t size = segmentSize(state->oldest);
+  uint32_t lost = size > state->readOffset ? (size - state->readOffset) / STORE_FORWARD_RECORD_LEN : 0;
+  state->dropped += lost;
+  state->pending -= lost < state->pending ? lost : state->pending;
+  storage.remove(state->oldest, storage.context);
+  state->oldest++;
+  state->readOffset = 0;
+}
+
+int StoreForwardQueue::push(const BufferedSample* samples, int count) {
+  begin();
+  uint8_t chunk[STORE_FORWARD_CHUNK_RECORDS * STORE_FORWARD_RECORD_LEN];
+  int stored = 0;
+  while (stored < count) {
+    uint32_t size = segmentSize(state->newest);
+    //a torn record from a power loss would shift every later one, start over in a new segment
+    if (size % STORE_FORWARD_RECORD_LEN != 0 || size + STORE_FORWARD_RECORD_LEN > config.segmentBytes) {
+      rotate();
+      size = 0;
+    }
+    int records = (config.segmentBytes - size) / STORE_FORWARD_RECORD_LEN;
+    if (records > count - stored) records = count - stored;
+    if (records > STORE_FORWARD_CHUNK_RECORDS) records = STORE_FORWARD_CHUNK_RECORDS;
+    for (int i = 0; i < records; i++) {
+      encodeRecord(&chunk[i * STORE_FORWARD_RECORD_LEN], samples[stored + i]);
+    }
+    if (!storage.append(state->newest, chunk, records * STORE_FORWARD_RECORD_LEN, storage.context)) break;
+    stored += records;
+    state->pending += records;
+  }
+  return stored;
+}
+
+int StoreForwardQueue::peek(BufferedSample* samples, int max, QueuePosition& end) {
+  begin();
+  end.segment = state->oldest;
+  end.offset = state->readOffset;
+  end.records = 0;
+  end.corrupted = 0;
+  uint8_t chunk[STORE_FORWARD_CHUNK_RECORDS * STORE_FORWARD_RECORD_LEN];
+  int count = 0;
+  while (count < max) {
+    int wanted = max - count < STORE_FORWARD_CHUNK_RECORDS ? max - count : STORE_FORWARD_CHUNK_RECORDS;
+    int length = storage.read(end.segment, end.offset, chunk, wanted * STORE_FORWARD_RECORD_LEN, storage.context);
+    int records = length > 0 ? length / STORE_FORWARD_RECORD_LEN : 0;
+    if (records == 0) {
+      if (end.segment == state->newest) break;
+      end.segment++; //segment done, or missing after a rotation
+      end.offset = 0;
+      continue;
+    }
+    for (int i = 0; i < records; i++) {
+      if (decodeRecord(&chunk[i * STORE_FORWARD_RECORD_LEN], samples[count])) {
+        count++;
+      } else {
+        end.corrupted++;
+      }
+    }
+    end.records += records;
+    end.offset += records * STORE_FORWARD_RECORD_LEN;
+  }
+  return count;
+}
+
+void StoreForwardQueue::commit(const QueuePosition& end) {
+  if (end.segment < state->oldest) return; //rotated away since the peek, already counted as dropped
+  while (state->oldest < end.segment) {
+    storage.remove(state->oldest, storage.context);
+    state->oldest++;
+  }
+  state->readOffset = end.offset;
+  state->pending -= end.records < state->pending ? end.records : state->pending;
+  state->dropped += end.corrupted;
+  if (state->oldest == state->newest && state->readOffset >= segmentSize(state->newest)) {
+    //everything delivered, the next push starts a fresh segment
+    storage.remove(state->newest, storage.context);
+    state->newest++;
+    state->oldest = state->newest;
+    state->readOffset = 0;
+    state->pending = 0;
+  }
+}
+
+void StoreForwardQueue::encodeRecord(uint8_t* record, const BufferedSample& sample) {
+  record[0] = STORE_FORWARD_MAGIC;
+  wireWriteU16(&record[1], state->powerCycle);
+  wireWriteU32(&record[3], sample.time);
+  record[7] = sample.waterLevel;
+  wireWriteU16(&record[8], sample.voltageMv);
+  record[10] = sample.charge;
+  record[11] = sample.fillPercent;
+  record[12] = sample.fillFlags;
+  wireWriteU16(&record[13], crc16(record, STORE_FORWARD_RECORD_LEN - 2));
+}
+
+bool StoreForwardQueue::decodeRecord(const uint8_t* record, BufferedSample& sample) {
+  if (record[0] != STORE_FORWARD_MAGIC) return false;
+  if (wireReadU16(&record[13]) != crc16(record, STORE_FORWARD_RECORD_LEN - 2)) return false;
+  sample.time = wireReadU16(&record[1]) == state->powerCycle ? wireReadU32(&record[3]) : SAMPLE_TIME_UNKNOWN;
+  sample.waterLevel = record[7];
+  sample.voltageMv = wireReadU16(&record[8]);
+  sample.charge = record[10];
+  sample.fillPercent = record[11];
+  sample.fillFlags = record[12];
+  return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "SampleBuffer.h"
+#include "SegmentStorage.h"
+
+#define STORE_FORWARD_RECORD_LEN    15    //magic u8, power cycle u16, sample 10 bytes, CRC-16 u16
+#define STORE_FORWARD_MAGIC         0x5B
+#define STORE_FORWARD_MAX_LIST      32    //segments looked at when the state is rebuilt
+
+// Readings the gateway did not confirm, kept on flash until it answers again.
+// Records are appended to numbered segment files and never rewritten: the read
+// cursor lives in a caller provided struct, normally in RTC memory, and a segment
+// is deleted once all its records are delivered. When maxSegments are full the
+// oldest segment is deleted, so the queue is bounded and wear is spread over whole
+// files. After a power loss the cursor is rebuilt from the files, already delivered
+// records of the oldest segment may then be sent twice. Sample times come from a clock
+// that restarts at power on, so every record carries the power cycle it was taken in;
+// records of an earlier cycle are read back with time SAMPLE_TIME_UNKNOWN.
+
+typedef struct {
+  uint32_t segmentBytes;  //new segment once the current one is this big
+  uint8_t maxSegments;
+} StoreForwardConfig;
+
+typedef struct {
+  bool valid;
+  uint32_t oldest;        //segment holding the next undelivered record
+  uint32_t newest;        //segment appended to
+  uint32_t readOffset;    //bytes of the oldest segment already delivered
+  uint32_t pending;       //records not yet delivered
+  uint32_t dropped;       //records lost to rotation or a bad CRC
+  uint16_t powerCycle;    //one past the newest stored cycle when the state was rebuilt
+} StoreForwardState;
+
+typedef struct {
+  uint32_t segment;
+  uint32_t offset;
+  uint16_t records;       //records passed, corrupted ones included
+  uint16_t corrupted;
+} QueuePosition;
+
+class StoreForwardQueue {
+    public:
+        StoreForwardQueue(StoreForwardState* state, const SegmentStorage& storage, const StoreForwardConfig& config);
+        void begin(); //rebuilds the state from the stored segments when RTC memory was lost
+        int push(const BufferedSample* samples, int count); //samples stored
+        int peek(BufferedSample* samples, int max, QueuePosition& end); //oldest undelivered samples
+        void commit(const QueuePosition& end); //samples up to end were delivered
+        bool isEmpty() const { return state->pending == 0; };
+        uint32_t getPending() const { return state->pending; };
+        uint32_t getDropped() const { return state->dropped; };
+    private:
+        StoreForwardState* state;
+        SegmentStorage storage;
+        StoreForwardConfig config;
+        uint32_t segmentSize(uint32_t segment);
+        void rotate();
+        bool newestPowerCycle(uint16_t& powerCycle);
+        void encodeRecord(uint8_t* record, const BufferedSample& sample);
+        bool decodeRecord(const uint8_t* record, BufferedSample& sample);
+};
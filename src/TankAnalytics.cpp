@@ -0,0 +1,84 @@
+#include "TankAnalytics.h"
+#include <math.h>
+
+#define RATE_DEVIATION_FLOOR  1.0f //percent per hour, keeps a perfectly steady history from alerting on noise
+
+TankAnalytics::TankAnalytics(TankAnalyticsState* state, const TankAnalyticsConfig& config) {
+  this->state = state;
+  this->config = config;
+}
+
+TankStats TankAnalytics::update(uint32_t now, uint8_t levelPercent, bool measured) {
+  TankStats stats;
+  stats.rate = 0;
+  stats.anomalyScore = 0;
+
+  if (!state->valid || now <= state->lastTime) {
+    if (!state->valid) {
+      state->valid = true;
+      state->levelEwma = levelPercent;
+      state->rateEwma = 0;
+      state->rateVariance = 0;
+      state->lastTransitionTime = now;
+      state->activeAlerts = 0;
+      state->pendingAlerts = 0;
+    }
+    state->lastTime = now;
+    state->lastLevel = levelPercent;
+  } else {
+    uint32_t elapsedS = now - state->lastTime;
+    //irregular sample spacing, so the weight depends on the time elapsed
+    float alpha = (float)elapsedS / (config.timeConstantS + elapsedS);
+    if (measured) {
+      stats.rate = ((int)levelPercent - (int)state->lastLevel) * 3600.0f / elapsedS;
+
+      //scored against the history before this sample, so a sudden drain does not dilute itself
+      if (stats.rate < 0) {
+        float deviation = sqrtf(state->rateVariance);
+        if (deviation < RATE_DEVIATION_FLOOR) deviation = RATE_DEVIATION_FLOOR;
+        float excess = (state->rateEwma - stats.rate) / deviation;
+        stats.anomalyScore = excess > 0 ? excess : 0;
+      }
+
+      float rateDelta = stats.rate - state->rateEwma;
+      state->rateEwma += alpha * rateDelta;
+      state->rateVariance = (1 - alpha) * (state->rateVariance + alpha * rateDelta * rateDelta);
+    }
+    state->levelEwma += alpha * (levelPercent - state->levelEwma);
+
+    if (levelPercent != state->lastLevel) state->lastTransitionTime = now;
+    state->lastTime = now;
+    state->lastLevel = levelPercent;
+  }
+
+  uint8_t alerts = 0;
+  if (stats.anomalyScore >= config.anomalyThreshold && -stats.rate >= config.minDrainRate) alerts |= TANK_ALERT_FAST_DRAIN;
+  if (levelPercent <= config.lowLevelPercent) alerts |= TANK_ALERT_LOW_LEVEL;
+  state->pendingAlerts |= alerts & ~state->activeAlerts;
+  //a fast drain is a single sample, it stays latched until the level stops dropping
+  if ((state->activeAlerts & TANK_ALERT_FAST_DRAIN) && stats.rate < 0) alerts |= TANK_ALERT_FAST_DRAIN;
+  state->activeAlerts = alerts;
+
+  stats.levelEwma = state->levelEwma;
+  stats.rateEwma = state->rateEwma;
+  stats.sinceTransitionS = now - state->lastTransitionTime;
+  stats.activeAlerts = state->activeAlerts | state->pendingAlerts;
+  stats.pendingAlerts = state->pendingAlerts;
+  return stats;
+}
+
+void TankAnalytics::alertsDelivered(uint8_t alerts) {
+  state->pendingAlerts &= ~alerts;
+}
+
+void TankAnalytics::toWire(const TankStats& stats, uint8_t* value) {
+  float rate = stats.rateEwma * 10;
+  if (rate > INT16_MAX) rate = INT16_MAX;
+  if (rate < INT16_MIN) rate = INT16_MIN;
+  float score = stats.anomalyScore * 10;
+  value[0] = (uint8_t)(stats.levelEwma + 0.5f);
+  wireWriteU16(&value[1], (uint16_t)(int16_t)lroundf(rate));
+  wireWriteU32(&value[3], stats.sinceTransitionS);
+  value[7] = score > 255 ? 255 : (uint8_t)score;
+  value[8] = stats.activeAlerts;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+#include <WireFormat.h>
+
+// Incremental statistics of the tank level, updated once per sample in constant time
+// and memory: smoothed level, smoothed fill/drain rate and its variance, time since the
+// level last moved, and an anomaly score telling how much faster than usual the tank is
+// draining. An alert is pending from its rising edge until the caller reports it
+// delivered, so one event keeps asking for an immediate send until the gateway has it,
+// even when the condition itself is already gone. Levels known only from the float
+// switch jump between 0 and 100%; they move the averages and the low level alert but are
+// no rate. State lives in a caller provided struct, normally kept in RTC memory.
+
+#define TANK_ALERT_FAST_DRAIN   0x01 //drain rate far above the usual one, possible leak
+#define TANK_ALERT_LOW_LEVEL    0x02 //level at or below lowLevelPercent
+
+typedef struct {
+  bool valid;
+  uint32_t lastTime;        //seconds
+  uint8_t lastLevel;        //percent
+  float levelEwma;          //percent
+  float rateEwma;           //percent per hour, negative when draining
+  float rateVariance;       //(percent per hour)^2
+  uint32_t lastTransitionTime;
+  uint8_t activeAlerts;     //TANK_ALERT_*
+  uint8_t pendingAlerts;    //raised, not yet delivered
+} TankAnalyticsState;
+
+typedef struct {
+  float levelEwma;
+  float rate;               //percent per hour, this sample
+  float rateEwma;
+  uint32_t sinceTransitionS;
+  float anomalyScore;       //standard deviations of drain beyond the usual rate, 0 when not draining
+  uint8_t activeAlerts;     //active or pending, as reported to the gateway
+  uint8_t pendingAlerts;    //raised and not yet delivered, worth an immediate send
+} TankStats;
+
+typedef struct {
+  uint32_t timeConstantS;   //smoothing horizon of the averages
+  float anomalyThreshold;   //score that raises TANK_ALERT_FAST_DRAIN
+  float minDrainRate;       //percent per hour, slower drains never alert
+  uint8_t lowLevelPercent;
+} TankAnalyticsConfig;
+
+class TankAnalytics {
+    public:
+        TankAnalytics(TankAnalyticsState* state, const TankAnalyticsConfig& config);
+        TankStats update(uint32_t now, uint8_t levelPercent, bool measured); //measured false: float switch only
+        void alertsDelivered(uint8_t alerts);
+        static void toWire(const TankStats& stats, uint8_t* value); //WIRE_TANK_STATS_LEN bytes of FIELD_TANK_STATS
+    private:
+        TankAnalyticsState* state;
+        TankAnalyticsConfig config;
+};
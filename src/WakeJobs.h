@@ -0,0 +1,31 @@
+#pragma once
+#include "JobGraph.h"
+
+// Job graph of a LOW_POWER_MODE wake cycle, shared by the firmware and tools/job_sim.
+// Sensing does not need the configuration or the radio, so it runs while they start;
+// only the send waits for both sides.
+
+enum WakeJob {
+  JOB_CONFIG_LOAD,
+  JOB_WATER_LEVEL,        //burst, probe ladder and tank analytics
+  JOB_BATTERY,
+  JOB_RADIO_INIT,         //channel setup and ESP-NOW init, only when a send is expected
+  JOB_ENCODE,             //report decision and batch frame
+  JOB_SEND,
+  JOB_SCHEDULE,           //next wakeup
+  WAKE_JOB_COUNT
+};
+
+static const char* const wakeJobNames[WAKE_JOB_COUNT] = {
+  "config load", "water level", "battery", "radio init", "encode", "send", "schedule"
+};
+
+static const uint32_t wakeJobDependencies[WAKE_JOB_COUNT] = {
+  0,                                              //JOB_CONFIG_LOAD
+  0,                                              //JOB_WATER_LEVEL
+  0,                                              //JOB_BATTERY
+  JOB_BIT(JOB_CONFIG_LOAD),                       //JOB_RADIO_INIT
+  JOB_BIT(JOB_WATER_LEVEL) | JOB_BIT(JOB_BATTERY), //JOB_ENCODE
+  JOB_BIT(JOB_ENCODE) | JOB_BIT(JOB_RADIO_INIT),  //JOB_SEND
+  JOB_BIT(JOB_WATER_LEVEL) | JOB_BIT(JOB_BATTERY)  //JOB_SCHEDULE
+};
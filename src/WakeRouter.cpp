@@ -0,0 +1,53 @@
+#include "WakeRouter.h"
+
+WakeRouter::WakeRouter(WakeRouterState* state, const WakeHal& hal, const WakeRouterConfig& config) {
+  this->state = state;
+  this->hal = hal;
+  this->config = config;
+}
+
+WakeRoute WakeRouter::route() {
+  cause = hal.wakeCause(hal.context);
+  switch (cause) {
+    case WAKE_CAUSE_TIMER:
+      return WAKE_ROUTE_HEARTBEAT;
+    case WAKE_CAUSE_SENSOR:
+      countSensorWake(hal.nowS(hal.context));
+      return WAKE_ROUTE_LEVEL_EDGE;
+    case WAKE_CAUSE_BUTTON:
+      return WAKE_ROUTE_USER;
+    case WAKE_CAUSE_POWER_ON:
+      state->windowStart = 0;
+      state->sensorWakes = 0;
+      state->pinWakeSuspended = false;
+      return WAKE_ROUTE_FULL;
+    default:
+      return WAKE_ROUTE_FULL;
+  }
+}
+
+void WakeRouter::countSensorWake(uint32_t now) {
+  if (state->sensorWakes == 0 || now - state->windowStart >= config.stormWindowS) {
+    state->windowStart = now;
+    state->sensorWakes = 0;
+  }
+  state->sensorWakes++;
+  if (state->sensorWakes >= config.maxSensorWakes) {
+    state->pinWakeSuspended = true;
+    state->suspendedUntil = now + config.stormWindowS;
+    state->sensorWakes = 0;
+  }
+}
+
+void WakeRouter::arm(uint8_t sensorLevel, uint32_t intervalS) {
+  uint32_t now = hal.nowS(hal.context);
+  if (state->pinWakeSuspended && (int32_t)(now - state->suspendedUntil) >= 0) {
+    state->pinWakeSuspended = false;
+  }
+  hal.enableTimerWakeup(intervalS, hal.context);
+  hal.enableButtonWakeup(config.buttonPin, config.buttonLevel, hal.context);
+  if (config.maxSensorWakes > 0 && !state->pinWakeSuspended) {
+    //armed against the level read now, not the confirmed one, or an unconfirmed change would wake the chip at once
+    hal.enablePinWakeup(config.sensorPin, sensorLevel ? 0 : 1, hal.context);
+  }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+
+// Decides what a wake is for and arms the wake sources before deep sleep. Besides the
+// timer and the button, the float switch wakes the chip as soon as it leaves the level
+// seen in the last burst, so a tank running dry is noticed right away instead of at the
+// next timer wake. A switch that keeps bouncing would keep the chip awake, so after
+// maxSensorWakes sensor wakes within stormWindowS the pin wake is suspended for one
+// window and only the timer is used. All hardware access goes through WakeHal, so the
+// routing runs on a host with simulated edges. State lives in a caller provided struct,
+// normally kept in RTC memory.
+
+enum WakeCause {
+  WAKE_CAUSE_POWER_ON,      //reset or first boot, not a deep sleep wake
+  WAKE_CAUSE_TIMER,
+  WAKE_CAUSE_SENSOR,        //level change on the sensor pin
+  WAKE_CAUSE_BUTTON,
+  WAKE_CAUSE_OTHER
+};
+
+enum WakeRoute {
+  WAKE_ROUTE_FULL,          //everything is read and the configuration reloaded
+  WAKE_ROUTE_HEARTBEAT,     //timer: sample, buffer, maybe report
+  WAKE_ROUTE_LEVEL_EDGE,    //sensor: water level confirmed within this wake, short next interval, battery reused
+  WAKE_ROUTE_USER           //button: read everything and report at once
+};
+
+typedef struct {
+  WakeCause (*wakeCause)(void* context);
+  void (*enableTimerWakeup)(uint32_t seconds, void* context);
+  void (*enablePinWakeup)(uint8_t pin, uint8_t level, void* context);     //wake when pin reads level
+  void (*enableButtonWakeup)(uint8_t pin, uint8_t level, void* context);
+  uint32_t (*nowS)(void* context);                                        //seconds on a clock NTP does not move, e.g. the RTC timer
+  void* context;
+} WakeHal;
+
+typedef struct {
+  uint32_t windowStart;     //seconds
+  uint8_t sensorWakes;      //within the current window
+  bool pinWakeSuspended;
+  uint32_t suspendedUntil;
+} WakeRouterState;
+
+typedef struct {
+  uint8_t sensorPin;
+  uint8_t buttonPin;
+  uint8_t buttonLevel;      //level of the pressed button
+  uint8_t maxSensorWakes;   //per stormWindowS before the pin wake is suspended, 0 = sensor pin never wakes the chip
+  uint32_t stormWindowS;
+} WakeRouterConfig;
+
+class WakeRouter {
+    public:
+        WakeRouter(WakeRouterState* state, const WakeHal& hal, const WakeRouterConfig& config);
+        WakeRoute route();
+        void arm(uint8_t sensorLevel, uint32_t intervalS); //sensorLevel: level the pin reads now
+        WakeCause getCause() { return cause; };
+        bool isPinWakeSuspended() { return state->pinWakeSuspended; };
+    private:
+        WakeRouterState* state;
+        WakeHal hal;
+        WakeRouterConfig config;
+        WakeCause cause = WAKE_CAUSE_POWER_ON;
+        void countSensorWake(uint32_t now);
+};
@@ -0,0 +1,43 @@
+#include "WakeScheduler.h"
+
+WakeScheduler::WakeScheduler(WakeSchedulerState* state, const WakePolicy& policy) {
+  this->state = state;
+  this->policy = policy;
+  if (this->policy.activeWakes > 16) this->policy.activeWakes = 16;
+}
+
+WakeDecision WakeScheduler::next(uint8_t level, bool levelPending, uint8_t charge) {
+  bool changed = levelPending || (state->valid && level != state->lastLevel);
+  state->changeHistory = (uint16_t)((state->changeHistory << 1) | (changed ? 1 : 0));
+  state->lastLevel = level;
+
+  uint16_t activeMask = (uint16_t)((1UL << policy.activeWakes) - 1);
+  WakeDecision decision;
+  decision.active = (state->changeHistory & activeMask) != 0;
+  decision.lowBattery = charge <= policy.lowCharge;
+  decision.criticalBattery = charge <= policy.criticalCharge;
+
+  uint32_t levelInterval;
+  if (!state->valid) {
+    levelInterval = policy.baseIntervalS;
+  } else if (decision.active) {
+    levelInterval = policy.minIntervalS;
+  } else {
+    //back off gradually, a tank that just stopped changing may start again
+    levelInterval = state->lastIntervalS * 2;
+    if (levelInterval > policy.baseIntervalS) levelInterval = policy.baseIntervalS;
+  }
+  state->valid = true;
+  state->lastIntervalS = levelInterval;
+
+  uint32_t interval = levelInterval;
+  if (decision.criticalBattery) {
+    interval = policy.maxIntervalS;
+  } else if (decision.lowBattery) {
+    interval *= 2;
+  }
+  if (interval < policy.minIntervalS) interval = policy.minIntervalS;
+  if (interval > policy.maxIntervalS) interval = policy.maxIntervalS;
+  decision.intervalS = interval;
+  return decision;
+}
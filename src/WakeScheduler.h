@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+
+// Picks the deep sleep duration of the next cycle. While the water level moves, or a
+// change is waiting for confirmation, the sensor wakes every minIntervalS; once it has
+// been stable for activeWakes cycles the interval doubles per cycle back up to
+// baseIntervalS. Low battery stretches the interval, critical battery jumps to the
+// maximum. State lives in a caller provided struct, normally kept in RTC memory.
+
+typedef struct {
+  bool valid;
+  uint8_t lastLevel;
+  uint16_t changeHistory;   //one bit per cycle, bit 0 = last cycle, set when the level moved
+  uint32_t lastIntervalS;
+} WakeSchedulerState;
+
+typedef struct {
+  uint32_t minIntervalS;    //while the level is changing
+  uint32_t baseIntervalS;   //stable level, healthy battery
+  uint32_t maxIntervalS;
+  uint8_t activeWakes;      //cycles after the last change still sampled at minIntervalS, at most 16
+  uint8_t lowCharge;        //percent, interval doubled at or below
+  uint8_t criticalCharge;   //percent, maxIntervalS at or below
+} WakePolicy;
+
+typedef struct {
+  uint32_t intervalS;
+  bool active;              //level changed within the last activeWakes cycles
+  bool lowBattery;
+  bool criticalBattery;
+} WakeDecision;
+
+class WakeScheduler {
+    public:
+        WakeScheduler(WakeSchedulerState* state, const WakePolicy& policy);
+        WakeDecision next(uint8_t level, bool levelPending, uint8_t charge);
+    private:
+        WakeSchedulerState* state;
+        WakePolicy policy;
+};
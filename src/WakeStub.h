@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+
+// Decision of the deep sleep wake stub, the code that runs from RTC memory before the
+// bootloader. A timer wake that finds the sensor at the level of the last full boot goes
+// straight back to sleep, at most remainingSkips times in a row; anything else boots.
+// The stub may only call code in RTC memory, so the decision is forced inline and must
+// not use floating point or 64 bit arithmetic.
+
+#define WAKE_STUB_INLINE inline __attribute__((always_inline))
+
+typedef struct {
+  bool armed;               //set by the full boot right before deep sleep
+  uint8_t expectedLevel;    //sensor pin level of the last burst
+  uint16_t remainingSkips;
+  uint16_t skippedWakes;    //since the last full boot
+  uint64_t intervalUs;      //timer rearmed by the stub, precomputed by the full boot
+} WakeStubState;
+
+enum WakeStubAction {
+  WAKE_STUB_SLEEP,
+  WAKE_STUB_BOOT
+};
+
+WAKE_STUB_INLINE WakeStubAction wakeStubDecide(WakeStubState* state, bool timerWake, uint8_t sensorLevel) {
+  if (!state->armed || !timerWake || sensorLevel != state->expectedLevel || state->remainingSkips == 0) {
+    state->armed = false;
+    return WAKE_STUB_BOOT;
+  }
+  state->remainingSkips--;
+  state->skippedWakes++;
+  return WAKE_STUB_SLEEP;
+}
+
+//Wakes the stub may skip before the next full boot. Skipped wakes add no samples, so the
+//buffered ones must still leave before their deadline: the wake after the last skip boots in time.
+inline uint16_t wakeStubSkips(uint32_t secondsUntilDeadline, uint32_t intervalS, uint16_t maxSkips) {
+  uint32_t skips = intervalS > 0 ? secondsUntilDeadline / intervalS : 0;
+  if (skips > 0) skips--;
+  return skips > maxSkips ? maxSkips : (uint16_t)skips;
+}
@@ -1,34 +1,84 @@
 #include <Arduino.h>
 #include <stdio.h>
-#include <Battery18650Stats.h>
 #include "Button2.h"
 #include "AppConfig.h"
 #include "NTPTime.h"
 #include "ESPNow.h"
+#include "SampleAggregator.h"
+#include "BootProfiler.h"
+#include "ReportPolicy.h"
+#include "LevelSampler.h"
+#include "BatteryMonitor.h"
+#include "WakeScheduler.h"
+#include "SampleBuffer.h"
+#include "LevelLadder.h"
+#include "TankAnalytics.h"
+#include "WakeRouter.h"
+#include "Esp32WakeHal.h"
+#include "Esp32WakeStub.h"
+#include "WakeStub.h"
+#include "WakeJobs.h"
+#include "Esp32JobRunner.h"
+#include "StoreForwardQueue.h"
+#include "LittleFsSegmentStorage.h"
+#include "LogExporter.h"
+#include <soc/gpio_reg.h>
+#include <esp_timer.h>
+#include <esp_rtc_time.h>
 #include <WiFi.h>
 #include "PersistentLog.h"
 #include "ESPLogMacros.h"
 #include "Display.h"
 
 #define LOW_POWER_MODE
+#define SENSOR_EDGE_WAKE //a water level change on SENSOR_PIN wakes the chip from deep sleep
+#define WAKE_STUB_FAST_PATH //timer wakes with an unchanged sensor go back to sleep before the bootloader runs
+#define WAKE_JOB_GRAPH //wake cycle phases run as concurrent jobs, the radio starts while the sensors are read
 // #define DISPLAY_ENABLED
 // #define NTP_TIME_ENABLED
-#define LOG_LEVEL                           ESP_LOG_VERBOSE
+#define LOG_LEVEL                           ESP_LOG_VERBOSE //runtime level, tags of this project are filtered at compile time in ESPLogMacros.h
 #define ADC_EN                              14 //ADC_EN is the ADC detection enable port
 #define ADC_PIN                             34
 #define SENSOR_PIN                          12
-#define CONV_FACTOR                          1.8
-#define READS                               30
+// #define LEVEL_PROBE_PINS                 { 25, 26, 27, 13 } //level ladder, bottom probe first, only on boards with probes fitted
+#define LEVEL_PROBE_WET_LEVEL                0 //pin level of a probe in water, probes pull the pin to ground
+#define LEVEL_PROBES_BELOW_SWITCH            0 //probes mounted below the float switch, 0 = ladder not checked against the switch
 #define MIN_USB_VOL                          4.8 //volts
 #define TIME_STRING_LENGTH                 100 
 #define MINIMUM_TIME_LONG_CLICK            200 //ms
-#define DOMOTICZ_VOLTAGE_DEVICE_ID           6
-#define DOMOTICZ_CHARGE_DEVICE_ID            7
 #define BATTERY_INFO_UPDATE_INTERVAL        10 //seconds
-#define DOMOTICZ_WATER_LEVEL_DEVICE_ID       8
 #define WATER_LEVEL_INFO_UPDATE_INTERVAL    10 //seconds
 #define DEEP_SLEEP_TIMEOUT                  15 //seconds without interaction to start deep sleep
-#define LOG_TAG_MAIN                        "MAIN"
+#define ESPNOW_FLUSH_DEADLINE_MS           500 //max time waiting for send confirmations before deep sleep
+#define REPORT_VOLTAGE_DEADBAND_MV          50 //smaller voltage changes are not reported
+#define REPORT_CHARGE_DEADBAND               2 //percent
+#define REPORT_HEARTBEAT_CYCLES             12 //wake cycles without report before readings are sent anyway
+#define WATER_LEVEL_SAMPLES                 15 //reads per burst, majority decides
+#define WATER_LEVEL_SAMPLE_INTERVAL_US    2000 //burst spans about 30 ms
+#define WATER_LEVEL_HYSTERESIS               3 //extra votes needed to leave the confirmed level
+#define WATER_LEVEL_CONFIRM_WAKES            2 //consecutive bursts that must agree before a level change is reported
+#define WATER_LEVEL_EDGE_SETTLE_MS        2000 //wait before each confirming burst of a sensor edge wake
+#define SAMPLE_BUFFER_THRESHOLD             12 //buffered samples that turn the radio on
+#define SAMPLE_BUFFER_MAX_LATENCY        21600 //seconds, oldest buffered sample waits at most this long
+#define STORE_FORWARD_DIR             "/queue"
+#define STORE_FORWARD_SEGMENT_BYTES       4096 //flash queue segment, one LittleFS block
+#define STORE_FORWARD_MAX_SEGMENTS           8 //undelivered readings kept on flash, about 2500
+#define STORE_FORWARD_BACKFILL_FRAMES        4 //queued frames sent per cycle once the gateway answers again
+#define LOG_EXPORT_FRAMES                    8 //log chunks sent per cycle while a log export runs
+#define TANK_TIME_CONSTANT               86400 //seconds, horizon of the level and rate averages
+#define TANK_ANOMALY_THRESHOLD             4.0 //drain rate standard deviations above the usual one that raise a leak alert
+#define TANK_MIN_ALERT_DRAIN               5.0 //percent per hour, slower drains never alert
+#define TANK_LOW_LEVEL_PERCENT              10
+#define SENSOR_WAKE_MAX_PER_WINDOW           6 //sensor wakes before the pin wake is suspended, a bouncing switch falls back to the timer
+#define SENSOR_WAKE_STORM_WINDOW          3600 //seconds
+#define WAKE_STUB_MAX_SKIPS                  5 //timer wakes in a row handled by the wake stub alone
+#define WAKE_MIN_INTERVAL                  300 //seconds, while the water level is changing
+#define WAKE_MAX_INTERVAL                 7200 //seconds, low battery limit
+#define WAKE_ACTIVE_CYCLES                   4 //cycles after a level change still sampled at WAKE_MIN_INTERVAL
+#define WAKE_LOW_CHARGE                     20 //percent, sleep interval doubled
+#define WAKE_CRITICAL_CHARGE                10 //percent, WAKE_MAX_INTERVAL used
+#define WAKE_JOB_RADIO_STACK              8192 //bytes, config, radio and send jobs, the other jobs use JOB_DEFAULT_STACK
+#define LOG_TAG_MAIN                        MAIN
 
 struct {
   char prevTime[TIME_STRING_LENGTH];
@@ -55,6 +105,10 @@ struct {
   int lastValue; 
   boolean valueChanged;
   int valueOnDisplay = -1;
+  uint8_t fillPercent = LEVEL_PERCENT_UNKNOWN;
+  uint8_t wetProbes;
+  boolean fillFault;
+  int fillPercentOnDisplay = -1;
   boolean enableDisplayInfo = true;
 } myWaterLevelInfo;
 
@@ -62,12 +116,64 @@ int deepSleepTimer = DEEP_SLEEP_TIMEOUT;
 
 RTC_DATA_ATTR int bootCount = 0;
 
+RTC_DATA_ATTR ReportState reportState;
+ReportPolicy reportPolicy = ReportPolicy(&reportState, REPORT_VOLTAGE_DEADBAND_MV, REPORT_CHARGE_DEADBAND, REPORT_HEARTBEAT_CYCLES);
+
+int readSensorPin(void* context) {
+  return digitalRead(SENSOR_PIN);
+}
+void delaySample(uint32_t us, void* context) {
+  delayMicroseconds(us);
+}
+
+RTC_DATA_ATTR LevelSamplerState levelSamplerState;
+LevelSampler levelSampler = LevelSampler(&levelSamplerState,
+  { &readSensorPin, &delaySample, NULL },
+  { WATER_LEVEL_SAMPLES, WATER_LEVEL_SAMPLE_INTERVAL_US, WATER_LEVEL_HYSTERESIS, WATER_LEVEL_CONFIRM_WAKES });
+
+RTC_DATA_ATTR WakeSchedulerState wakeSchedulerState;
+WakeScheduler wakeScheduler = WakeScheduler(&wakeSchedulerState,
+  { WAKE_MIN_INTERVAL, DEEP_SLEEP_WAKEUP, WAKE_MAX_INTERVAL, WAKE_ACTIVE_CYCLES, WAKE_LOW_CHARGE, WAKE_CRITICAL_CHARGE });
+uint32_t nextWakeupSeconds = DEEP_SLEEP_WAKEUP;
+
+RTC_DATA_ATTR SampleBufferState sampleBufferState;
+SampleBuffer sampleBuffer = SampleBuffer(&sampleBufferState, SAMPLE_BUFFER_THRESHOLD, SAMPLE_BUFFER_MAX_LATENCY);
+
+RTC_DATA_ATTR StoreForwardState storeForwardState;
+StoreForwardQueue storeForwardQueue = StoreForwardQueue(&storeForwardState, littleFsSegmentStorage(STORE_FORWARD_DIR),
+  { STORE_FORWARD_SEGMENT_BYTES, STORE_FORWARD_MAX_SEGMENTS });
+SemaphoreHandle_t storeForwardLock = xSemaphoreCreateMutex(); //continuous mode publishes from several tasks
+
+#ifdef LEVEL_PROBE_PINS
+const uint8_t levelProbePins[] = LEVEL_PROBE_PINS;
+LevelLadder levelLadder = LevelLadder(levelProbePins, sizeof(levelProbePins), LEVEL_PROBE_WET_LEVEL, LEVEL_PROBES_BELOW_SWITCH);
+#else
+LevelLadder levelLadder = LevelLadder(NULL, 0, LEVEL_PROBE_WET_LEVEL);
+#endif
+
+#ifdef SENSOR_EDGE_WAKE
+#define SENSOR_WAKES_PER_WINDOW SENSOR_WAKE_MAX_PER_WINDOW
+#else
+#define SENSOR_WAKES_PER_WINDOW 0
+#endif
+RTC_DATA_ATTR WakeRouterState wakeRouterState;
+WakeRouter wakeRouter = WakeRouter(&wakeRouterState, esp32WakeHal,
+  { SENSOR_PIN, BUTTON_RIGHT, 0, SENSOR_WAKES_PER_WINDOW, SENSOR_WAKE_STORM_WINDOW });
+WakeRoute wakeRoute = WAKE_ROUTE_FULL;
+
+RTC_DATA_ATTR BatteryReading lastBatteryReading; //reused on level edge wakes, millivolts 0 until the first measurement
+
+RTC_DATA_ATTR TankAnalyticsState tankAnalyticsState;
+TankAnalytics tankAnalytics = TankAnalytics(&tankAnalyticsState,
+  { TANK_TIME_CONSTANT, TANK_ANOMALY_THRESHOLD, TANK_MIN_ALERT_DRAIN, TANK_LOW_LEVEL_PERCENT });
+TankStats tankStats;
+
 TaskHandle_t waterLevelTaskHandle;
 
 TaskHandle_t deepSleepTaskHandle;
 
 
-Battery18650Stats battery(ADC_PIN, CONV_FACTOR, READS);
+BatteryMonitor battery = BatteryMonitor(ADC_PIN, ADC_EN);
 TaskHandle_t batteryInfoTaskHandle;
 
 Button2 rightButton(BUTTON_RIGHT);
@@ -75,12 +181,22 @@ Button2 leftButton(BUTTON_LEFT);
 
 char wifiNetworksBuff[512];
 
-PersistentLog persistentLog = PersistentLog();
+RTC_DATA_ATTR LogStoreState logStoreState;
+PersistentLog persistentLog = PersistentLog(&logStoreState);
+
+size_t readLogRecords(uint32_t& address, uint32_t limit, uint8_t* out, size_t capacity, void* context) {
+  return persistentLog.readRecords(address, limit, out, capacity);
+}
+
+RTC_DATA_ATTR LogExportState logExportState;
+LogExporter logExporter = LogExporter(&logExportState, { &readLogRecords, NULL });
+SemaphoreHandle_t logExportLock = xSemaphoreCreateMutex(); //continuous mode publishes from several tasks
 
 Config myConfig = Config();
 AppConfig myAppConfig = AppConfig(&myConfig);
 
 ESPNow espNow = ESPNow();
+SampleAggregator sampleAggregator = SampleAggregator(&espNow);
 
 #ifdef NTP_TIME_ENABLED
 TaskHandle_t updateTimeTaskHandle;
@@ -138,15 +254,78 @@ void ESPNow_OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
   espNow.onDataSent(mac_addr, status);
 }
 
+// ESPNow callback when data is received
+void ESPNow_OnDataRecv(const esp_now_recv_info_t *info, const uint8_t *data, int len) {
+  espNow.onDataRecv(info, data, len);
+}
+
+bool espNowStarted = false;
+void espNowInit() {
+  if (espNowStarted) return; //may already be up from the radio init job
+  espNowStarted = true;
+  const char* gatewayMacAddresses[CONFIG_MAX_GATEWAYS];
+  for (int i = 0; i < myConfig.espNowGatewayCount; i++) {
+    gatewayMacAddresses[i] = myConfig.espNowGatewayMacAddresses[i];
+  }
+  espNow.init(gatewayMacAddresses, myConfig.espNowGatewayCount, myConfig.wifiSSID);
+}
+
+/**
+ * Queues the log range a gateway asked for, a request for everything up to the newest record ends at the current end
+*/
+void acceptLogRequest() {
+  uint32_t from, to;
+  if (!espNow.takeLogRequest(from, to)) return;
+  if (to == 0) to = persistentLog.getEnd();
+  ESP_LOGI(LOG_TAG_MAIN, "Gateway requested the log from %u to %u", (unsigned)from, (unsigned)to);
+  xSemaphoreTake(logExportLock, portMAX_DELAY);
+  logExporter.start(from, to);
+  xSemaphoreGive(logExportLock);
+}
+
+/**
+ * Sends the next LOG_EXPORT_FRAMES chunks of a running log export, the cursor only moves past delivered ones
+*/
+void exportLog() {
+  acceptLogRequest();
+  xSemaphoreTake(logExportLock, portMAX_DELAY);
+  if (!logExporter.isActive()) {
+    xSemaphoreGive(logExportLock);
+    return;
+  }
+  uint8_t frameBuffer[WIRE_MAX_FRAME_LEN];
+  FrameEncoder frame(frameBuffer, sizeof(frameBuffer));
+  int frames = 0;
+  while (frames < LOG_EXPORT_FRAMES && logExporter.nextFrame(frame)) {
+    espNow.sendFrame(frame);
+    frames++;
+  }
+  if (espNow.flush(ESPNOW_FLUSH_DEADLINE_MS)) {
+    logExporter.commit();
+  } else {
+    logExporter.rewind(); //sent again from the same cursor next time
+  }
+  ESP_LOGI(LOG_TAG_MAIN, "Log export sent %d chunks, cursor at %u, ranges queued: %d%s", frames, (unsigned)logExporter.getCursor(),
+    logExporter.getQueued(), logExporter.isActive() ? "" : ", export complete");
+  xSemaphoreGive(logExportLock);
+}
+
+/**
+ * Streams the whole stored log to the gateway, continued over the next cycles until every chunk is delivered
+*/
 void publishLogContent() {
-  std::string jsonStr = persistentLog.readLogFileAsJsonPretty();
-  espNow.sendMessage(std::string(jsonStr), LOG);
-  PRINTF("Log content: %s\n", jsonStr.c_str());
+  persistentLog.flush();
+  xSemaphoreTake(logExportLock, portMAX_DELAY);
+  logExporter.start(0, persistentLog.getEnd()); //addresses below the oldest record start at it
+  xSemaphoreGive(logExportLock);
+  exportLog();
 }
 
 void serialInit() {
+  BootProfiler::begin(PHASE_SERIAL_INIT);
   Serial.begin(115200);
   delay(100);
+  BootProfiler::end(PHASE_SERIAL_INIT);
 }
 
 
@@ -172,13 +351,39 @@ void resetSleepTimers() {
 }
 
 
+void armWakeStub() {
+  #if defined(LOW_POWER_MODE) && defined(WAKE_STUB_FAST_PATH)
+  if (levelSampler.isPending() || tankStats.activeAlerts != 0) {
+    wakeStubDisarm(); //every wake must run the burst until the level settles
+    return;
+  }
+  uint16_t skips = wakeStubSkips(sampleBuffer.secondsUntilDeadline(monotonicSeconds()), nextWakeupSeconds, WAKE_STUB_MAX_SKIPS);
+  wakeStubArm(SENSOR_PIN, levelSampler.getLastBurstLevel(), skips, nextWakeupSeconds);
+  ESP_LOGI(LOG_TAG_MAIN, "Wake stub may skip the next %d wakes", (int)skips);
+  #endif
+}
+
 void initDeepSleep() {
+  sampleAggregator.flush();
+  espNow.flush(ESPNOW_FLUSH_DEADLINE_MS);
+  acceptLogRequest(); //a request answering this cycle's frames is served next cycle
   ESP_LOGI(LOG_TAG_MAIN, "Initiating deep sleep");
-  ESP_LOGI(LOG_TAG_MAIN, "Will wakeup after %d seconds", DEEP_SLEEP_WAKEUP);
-  esp_sleep_enable_ext0_wakeup(GPIO_NUM_35, 0);
+  ESP_LOGI(LOG_TAG_MAIN, "Will wakeup after %d seconds", (int)nextWakeupSeconds);
+  wakeRouter.arm(levelSampler.getLastBurstLevel(), nextWakeupSeconds);
+  armWakeStub();
+  if (wakeRouter.isPinWakeSuspended()) {
+    ESP_LOGW(LOG_TAG_MAIN, "Water sensor keeps waking the device, sensor wakeup suspended");
+  }
+  if (persistentLog.getDropped() > 0 || persistentLog.getWriteErrors() > 0) {
+    ESP_LOGW(LOG_TAG_MAIN, "Log records dropped: %d, failed log writes: %d",
+      (int)persistentLog.getDropped(), (int)persistentLog.getWriteErrors());
+  }
+  persistentLog.flush();
+  BootProfiler::begin(PHASE_SLEEP_DELAY);
   delay(200);
+  BootProfiler::end(PHASE_SLEEP_DELAY);
   Serial.flush();
-  esp_sleep_enable_timer_wakeup(DEEP_SLEEP_WAKEUP * 1000 * 1000);
+  BootProfiler::record(PHASE_AWAKE, (uint32_t)esp_timer_get_time());
   esp_deep_sleep_start();
 }
 void goToSleep() {
@@ -195,14 +400,20 @@ void logBootCount() {
   ++bootCount;
   ESP_LOGI(LOG_TAG_MAIN, "Boot number: %i", bootCount);
 }
-void logWakeupReason(){
+WakeRoute logWakeupReason(){
   esp_sleep_wakeup_cause_t wakeup_reason;
   wakeup_reason = esp_sleep_get_wakeup_cause();
 
   switch(wakeup_reason)
   {
     case ESP_SLEEP_WAKEUP_EXT0 : ESP_LOGI(LOG_TAG_MAIN, "Wakeup caused by external signal using RTC_IO"); break;
-    case ESP_SLEEP_WAKEUP_EXT1 : ESP_LOGI(LOG_TAG_MAIN, "Wakeup caused by external signal using RTC_CNTL"); break;
+    case ESP_SLEEP_WAKEUP_EXT1 : {
+      ESP_LOGI(LOG_TAG_MAIN, "Wakeup caused by water level change using RTC_CNTL");
+      #ifdef DISPLAY_ENABLED
+      display.turnOffDisplay();
+      #endif
+      break;
+    }
     case ESP_SLEEP_WAKEUP_TIMER : {
       ESP_LOGI(LOG_TAG_MAIN, "Wakeup caused by timer");
       #ifdef DISPLAY_ENABLED
@@ -214,6 +425,7 @@ void logWakeupReason(){
     case ESP_SLEEP_WAKEUP_ULP : ESP_LOGI(LOG_TAG_MAIN, "Wakeup caused by ULP program"); break;
     default : ESP_LOGI(LOG_TAG_MAIN, "Wakeup was not caused by deep sleep: %s", String(wakeup_reason)); break;
   }
+  return wakeRouter.route();
 }
 
 void deep_sleep_task(void *args) {
@@ -269,10 +481,86 @@ void createTimeTask() {
 }
 #endif
 
+/**
+ * Seconds counted by the RTC timer, which runs on through deep sleep and is not moved when NTP sets the clock.
+ * Sample ages are taken from it. It starts over at power-on, as does every RTC timestamp.
+*/
+uint32_t monotonicSeconds() {
+  return (uint32_t)(esp_rtc_get_time_us() / 1000000ULL);
+}
+
+BufferedSample currentSample(uint32_t now) {
+  return { now, (uint8_t)myWaterLevelInfo.lastValue, (uint16_t)(myBatteryInfo.lastVoltage * 1000), (uint8_t)myBatteryInfo.lastCharge,
+    myWaterLevelInfo.fillPercent, (uint8_t)(myWaterLevelInfo.fillFault ? WIRE_FILL_FLAG_FAULT : 0) };
+}
+
+/**
+ * Keeps readings the gateway did not confirm on flash, they are sent again by backfillStoredSamples()
+*/
+void storeUndelivered(const BufferedSample* samples, int count) {
+  xSemaphoreTake(storeForwardLock, portMAX_DELAY);
+  int stored = storeForwardQueue.push(samples, count);
+  ESP_LOGW(LOG_TAG_MAIN, "%d of %d undelivered samples queued on flash, queued: %d, dropped: %d",
+    stored, count, (int)storeForwardQueue.getPending(), (int)storeForwardQueue.getDropped());
+  xSemaphoreGive(storeForwardLock);
+}
+
+/**
+ * Sends queued readings in full batch frames after a delivery succeeded, at most STORE_FORWARD_BACKFILL_FRAMES per cycle
+*/
+void backfillStoredSamples() {
+  xSemaphoreTake(storeForwardLock, portMAX_DELAY);
+  storeForwardQueue.begin();
+  int frames = 0;
+  while (frames < STORE_FORWARD_BACKFILL_FRAMES && !storeForwardQueue.isEmpty()) {
+    BufferedSample samples[SAMPLE_BATCH_MAX_RECORDS];
+    QueuePosition end;
+    int count = storeForwardQueue.peek(samples, SAMPLE_BATCH_MAX_RECORDS, end);
+    if (count == 0) {
+      if (end.records == 0) break;
+      storeForwardQueue.commit(end); //only corrupted records, nothing to send
+      continue;
+    }
+    uint8_t frameBuffer[WIRE_MAX_FRAME_LEN];
+    FrameEncoder frame(frameBuffer, sizeof(frameBuffer));
+    encodeSampleBatch(frame, samples, count, monotonicSeconds());
+    frames++;
+    //the frame is flushed on its own, so a successful flush is the gateway confirming exactly these records
+    if (!espNow.sendFrame(frame) || !espNow.flush(ESPNOW_FLUSH_DEADLINE_MS)) break; //the rest waits for the next cycle
+    storeForwardQueue.commit(end);
+  }
+  if (frames > 0) {
+    ESP_LOGI(LOG_TAG_MAIN, "Backfilled %d frames, still queued: %d, dropped: %d",
+      frames, (int)storeForwardQueue.getPending(), (int)storeForwardQueue.getDropped());
+  }
+  xSemaphoreGive(storeForwardLock);
+}
+
+void publishReadings() {
+  #ifndef LOW_POWER_MODE
+  sampleAggregator.flush();
+  if (espNow.flush(ESPNOW_FLUSH_DEADLINE_MS)) {
+    backfillStoredSamples();
+    exportLog();
+  } else {
+    BufferedSample sample = currentSample(monotonicSeconds());
+    storeUndelivered(&sample, 1);
+  }
+  #endif
+  //in LOW_POWER_MODE readings are flushed once, right before deep sleep
+}
+
 void publishWaterLevelInfo(int waterLevel) {
-  char waterLevelBuff[100];
-  snprintf(waterLevelBuff, 100, "{\"idx\": %d, \"nvalue\": %d}", DOMOTICZ_WATER_LEVEL_DEVICE_ID, waterLevel);
-  espNow.sendMessage(std::string(waterLevelBuff), SENSOR_INFO);
+  sampleAggregator.addU8(FIELD_WATER_LEVEL, waterLevel);
+  if (myWaterLevelInfo.fillPercent != LEVEL_PERCENT_UNKNOWN) {
+    uint8_t fillLevel[WIRE_FILL_LEVEL_LEN] = { myWaterLevelInfo.fillPercent, myWaterLevelInfo.wetProbes,
+      (uint8_t)(myWaterLevelInfo.fillFault ? WIRE_FILL_FLAG_FAULT : 0) };
+    sampleAggregator.add(FIELD_FILL_LEVEL, fillLevel, sizeof(fillLevel));
+  }
+  uint8_t stats[WIRE_TANK_STATS_LEN];
+  TankAnalytics::toWire(tankStats, stats);
+  sampleAggregator.add(FIELD_TANK_STATS, stats, sizeof(stats));
+  publishReadings();
 }
 void printWaterLevelInfo() {
   if (waterLevelTaskHandle != NULL && eTaskGetState(waterLevelTaskHandle) == eSuspended) {
@@ -281,13 +569,16 @@ void printWaterLevelInfo() {
   }
   if (!myWaterLevelInfo.enableDisplayInfo) return;
 
-  boolean updateValue = myWaterLevelInfo.valueOnDisplay == -1 || (myWaterLevelInfo.lastValue != myWaterLevelInfo.valueOnDisplay);
+  boolean updateValue = myWaterLevelInfo.valueOnDisplay == -1 || (myWaterLevelInfo.lastValue != myWaterLevelInfo.valueOnDisplay)
+    || myWaterLevelInfo.fillPercent != myWaterLevelInfo.fillPercentOnDisplay;
   if (updateValue) {
     int waterLevel = myWaterLevelInfo.lastValue;
+    int fillPercent = myWaterLevelInfo.fillPercent == LEVEL_PERCENT_UNKNOWN ? -1 : myWaterLevelInfo.fillPercent;
     #ifdef DISPLAY_ENABLED
-    display.showWaterLevel(waterLevel);
+    display.showWaterLevel(waterLevel, fillPercent, myWaterLevelInfo.fillFault);
     #endif
     myWaterLevelInfo.valueOnDisplay = waterLevel;
+    myWaterLevelInfo.fillPercentOnDisplay = myWaterLevelInfo.fillPercent;
   }
 }
 void updateWaterLevelInfo(int waterLevel) {
@@ -299,13 +590,51 @@ void updateWaterLevelInfo(int waterLevel) {
   }
   myWaterLevelInfo.lastValue = waterLevel;
 }
-void waterLevelTask() {
-  int waterLevel = digitalRead(SENSOR_PIN);
+void readLevelLadder() {
+  if (levelLadder.getCount() == 0) return;
+  //one snapshot of every input, all probes are seen at the same instant
+  uint64_t gpioSnapshot = REG_READ(GPIO_IN_REG) | ((uint64_t)REG_READ(GPIO_IN1_REG) << 32);
+  LadderReading reading = levelLadder.decode(gpioSnapshot, myWaterLevelInfo.lastValue == 0);
+  myWaterLevelInfo.fillPercent = reading.percent;
+  myWaterLevelInfo.wetProbes = reading.wetMask;
+  myWaterLevelInfo.fillFault = reading.fault;
+  ESP_LOGI(LOG_TAG_MAIN, "Water fill level: %d%%", reading.percent);
+  if (reading.fault) {
+    ESP_LOGW(LOG_TAG_MAIN, "Level probe fault, wet probes: 0x%02x", reading.wetMask);
+  }
+}
+void updateTankAnalytics() {
+  //without probe ladder the float switch only tells full from empty
+  bool measured = myWaterLevelInfo.fillPercent != LEVEL_PERCENT_UNKNOWN;
+  uint8_t levelPercent = measured ? myWaterLevelInfo.fillPercent : (myWaterLevelInfo.lastValue == 0 ? 100 : 0);
+  tankStats = tankAnalytics.update(monotonicSeconds(), levelPercent, measured);
+  ESP_LOGI(LOG_TAG_MAIN, "Tank level average: %.1f%%, rate: %.1f%%/h, average rate: %.1f%%/h, anomaly: %.1f, alerts: 0x%02x",
+    tankStats.levelEwma, tankStats.rate, tankStats.rateEwma, tankStats.anomalyScore, tankStats.activeAlerts);
+  if (tankStats.pendingAlerts) {
+    ESP_LOGW(LOG_TAG_MAIN, "Tank alert pending: 0x%02x", tankStats.pendingAlerts);
+  }
+}
+int readWaterLevel() {
+  int waterLevel = levelSampler.update();
+  //the edge already says the level moved, the confirming bursts run now instead of on later timer wakes
+  for (int i = 1; i < WATER_LEVEL_CONFIRM_WAKES && wakeRoute == WAKE_ROUTE_LEVEL_EDGE && levelSampler.isPending(); i++) {
+    taskDelay(WATER_LEVEL_EDGE_SETTLE_MS);
+    waterLevel = levelSampler.update();
+  }
 
-    ESP_LOGI(LOG_TAG_MAIN, "Water Sensor Level: %d", waterLevel);
+  ESP_LOGI(LOG_TAG_MAIN, "Water Sensor Level: %d", waterLevel);
+  if (levelSampler.getLastBurstLevel() != waterLevel || levelSampler.getLastHighVotes() % WATER_LEVEL_SAMPLES != 0) {
+    ESP_LOGI(LOG_TAG_MAIN, "Water sensor burst: %d/%d high, burst level %d, change pending: %d",
+      levelSampler.getLastHighVotes(), WATER_LEVEL_SAMPLES, levelSampler.getLastBurstLevel(), levelSampler.isPending());
+  }
 
-    updateWaterLevelInfo(waterLevel);
-    publishWaterLevelInfo(waterLevel);
+  updateWaterLevelInfo(waterLevel);
+  readLevelLadder();
+  updateTankAnalytics();
+  return waterLevel;
+}
+void waterLevelTask() {
+  publishWaterLevelInfo(readWaterLevel());
 }
 void water_level_task(void *arg) {
   while(true) {
@@ -318,12 +647,9 @@ void createWaterLevelTask() {
 }
 
 void publishBatteryInfo(int batteryChargeLevel, double batteryVoltage) {
-  char voltageBuff[100];
-  char chargeBuff[100];
-  snprintf(voltageBuff, 100, "{\"idx\": %d, \"nvalue\": 0, \"svalue\": \"%0.2f\"}", DOMOTICZ_VOLTAGE_DEVICE_ID, batteryVoltage);
-  snprintf(chargeBuff, 100, "{\"idx\": %d, \"nvalue\": 0, \"svalue\": \"%d\"}", DOMOTICZ_CHARGE_DEVICE_ID, batteryChargeLevel);
-  espNow.sendMessage(std::string(voltageBuff), SENSOR_INFO);
-  espNow.sendMessage(std::string(chargeBuff), SENSOR_INFO);
+  sampleAggregator.addU16(FIELD_BATTERY_VOLTAGE, (uint16_t)(batteryVoltage * 1000));
+  sampleAggregator.addU8(FIELD_BATTERY_CHARGE, batteryChargeLevel);
+  publishReadings();
 }
 void printBatteryInfo() {
   if (batteryInfoTaskHandle != NULL && eTaskGetState(batteryInfoTaskHandle) == eSuspended) {
@@ -370,16 +696,20 @@ void updateBatteryInfo(int batteryChargeLevel, double batteryVoltage) {
   // PRINTF("\nmyBatteryInfo.chargeChanged %s", myBatteryInfo.chargeChanged ? "true" : "false");
   // PRINTF("\nmyBatteryInfo.voltageChanged %s", myBatteryInfo.voltageChanged ? "true" : "false");
 }
-void batteryInfoTask() {
-  int batteryChargeLevel = battery.getBatteryChargeLevel();
-  double batteryVoltage = battery.getBatteryVolts();
+void readBatteryInfo() {
+  BatteryReading reading = battery.measure();
+  lastBatteryReading = reading;
+  int batteryChargeLevel = reading.charge;
+  double batteryVoltage = reading.millivolts / 1000.0;
 
   ESP_LOGI(LOG_TAG_MAIN, "Volts: %.2f", batteryVoltage);
   ESP_LOGI(LOG_TAG_MAIN, "Charge level: %d", batteryChargeLevel);
-  ESP_LOGI(LOG_TAG_MAIN, "Charge level (using the reference table): %d", battery.getBatteryChargeLevel(true));
 
   updateBatteryInfo(batteryChargeLevel, batteryVoltage);
-  publishBatteryInfo(batteryChargeLevel, batteryVoltage);
+}
+void batteryInfoTask() {
+  readBatteryInfo();
+  publishBatteryInfo(myBatteryInfo.lastCharge, myBatteryInfo.lastVoltage);
 }
 void battery_info_task(void *arg) {
   while(true) {
@@ -448,9 +778,13 @@ void update_display_task(void *arg) {
 #endif
 
 void pinoutInit() {
-  pinMode(ADC_EN, OUTPUT);
-  digitalWrite(ADC_EN, HIGH);
+  battery.begin(); //ADC_EN stays low, the divider is powered only while measuring
   pinMode(SENSOR_PIN, INPUT_PULLUP);
+#ifdef LEVEL_PROBE_PINS
+  for (size_t i = 0; i < sizeof(levelProbePins); i++) {
+    pinMode(levelProbePins[i], INPUT_PULLUP);
+  }
+#endif
 }
 
 void wifi_scan()
@@ -603,24 +937,211 @@ void onDisplayWakeUp() {
 }
 
 void loadAppConfig() {
+  BootProfiler::begin(PHASE_CONFIG_LOAD);
   myAppConfig.loadConfig();
+  BootProfiler::end(PHASE_CONFIG_LOAD);
 }
 
-int redirectToLittleFS(const char *szFormat, va_list args) {
-  return persistentLog.log(szFormat, args);
+/**
+ * Sends the boot profile in as many TELEMETRY frames as the phases need. The statistics only
+ * start over once every frame was confirmed, otherwise they go out again on the next report.
+*/
+void publishBootProfile() {
+  if (!BootProfiler::isReportDue()) return;
+  BootProfiler::logSummary();
+  uint8_t frameBuffer[WIRE_MAX_FRAME_LEN];
+  FrameEncoder frame(frameBuffer, sizeof(frameBuffer));
+  int phase = 0;
+  while (BootProfiler::encodeReport(frame, phase)) {
+    espNow.sendFrame(frame);
+  }
+  if (espNow.flush(ESPNOW_FLUSH_DEADLINE_MS)) {
+    BootProfiler::reset();
+  }
 }
 
-bool logFlushHandler(const char *buffer, int n) {
-  return persistentLog.flushHandler(buffer, n);
+int redirectToLittleFS(const char *szFormat, va_list args) {
+  return persistentLog.log(szFormat, args);
 }
 
 void logInit() {
-  persistentLog.flushCallback = &logFlushHandler;
+  #ifdef LOG_DISABLED
+  esp_log_level_set("*", ESP_LOG_NONE); //framework components too, nothing is written or persisted
+  #else
+  persistentLog.startWriter();
   esp_log_set_vprintf(&redirectToLittleFS);
   esp_log_level_set("*", LOG_LEVEL);
+  #endif
+}
+
+/**
+ * Picks the deep sleep length from the water level, an unconfirmed level change or sensor edge and the battery charge
+*/
+void scheduleNextWakeup() {
+  //an edge the bursts did not confirm still says the level sits at the switch, keep watching it closely
+  bool levelMoving = levelSampler.isPending() || wakeRoute == WAKE_ROUTE_LEVEL_EDGE;
+  WakeDecision decision = wakeScheduler.next(myWaterLevelInfo.lastValue, levelMoving, myBatteryInfo.lastCharge);
+  nextWakeupSeconds = decision.intervalS;
+  ESP_LOGI(LOG_TAG_MAIN, "Next wakeup in %d seconds, level active: %d, low battery: %d, critical battery: %d",
+    (int)nextWakeupSeconds, decision.active, decision.lowBattery, decision.criticalBattery);
+}
+
+//report of this cycle, filled by the encode job and sent by the send job
+typedef struct {
+  FlushReason reason;
+  bool telemetryDue;
+  uint32_t now;
+  uint8_t waterLevel;
+  uint16_t voltageMv;
+  uint8_t charge;
+} PendingReport;
+PendingReport pendingReport;
+uint8_t reportFrameBuffer[WIRE_MAX_FRAME_LEN];
+FrameEncoder reportFrame = FrameEncoder(reportFrameBuffer, sizeof(reportFrameBuffer));
+bool radioExpected = false; //decided before the readings exist, the radio init job only runs when true
+
+/**
+ * Guess from state known at wakeup whether this cycle sends, so the radio can start while the sensors are read.
+ * A wrong guess costs a radio start, a missed one only the overlap: sendReport() starts the radio anyway.
+*/
+bool isRadioExpected() {
+  //a level edge is not: most are ripples the bursts reject, a confirmed change starts the radio in sendReport()
+  if (BootProfiler::isReportDue() || wakeRoute == WAKE_ROUTE_USER) return true;
+  if (sampleBuffer.getCount() + 1 >= SAMPLE_BUFFER_THRESHOLD) return true;
+  return sampleBuffer.getCount() > 0 && sampleBuffer.secondsUntilDeadline(monotonicSeconds()) == 0;
+}
+
+/**
+ * Turns the radio on only when the readings changed meaningfully, a heartbeat is due or telemetry must be sent
+*/
+void prepareReport() {
+  PendingReport& report = pendingReport;
+  report.waterLevel = myWaterLevelInfo.lastValue;
+  report.voltageMv = (uint16_t)(myBatteryInfo.lastVoltage * 1000);
+  report.charge = myBatteryInfo.lastCharge;
+  report.now = monotonicSeconds();
+  sampleBuffer.push(currentSample(report.now));
+
+  ReportDecision decision = reportPolicy.evaluate(report.waterLevel, report.voltageMv, report.charge);
+  //routine samples wait for the batch, changes past the deadbands, heartbeats and tank alerts go out now,
+  //a button wake is someone standing at the tank, they get a report whatever changed
+  bool urgent = decision.send || tankStats.pendingAlerts != 0 || wakeRoute == WAKE_ROUTE_USER;
+  report.reason = sampleBuffer.flushReason(report.now, urgent);
+  report.telemetryDue = BootProfiler::isReportDue();
+
+  if (report.reason == FLUSH_NONE && !report.telemetryDue) {
+    reportPolicy.skip();
+    ESP_LOGI(LOG_TAG_MAIN, "%d samples buffered, radio stays off", sampleBuffer.getCount());
+    return;
+  }
+  ESP_LOGI(LOG_TAG_MAIN, "Reporting %d samples, reason: %d, water level changed: %d, voltage changed: %d, charge changed: %d, heartbeat: %d, pending alerts: 0x%02x, dropped samples: %d",
+    sampleBuffer.getCount(), report.reason, decision.waterLevelChanged, decision.voltageChanged, decision.chargeChanged,
+    decision.heartbeat, tankStats.pendingAlerts, sampleBuffer.getDropped());
+  if (report.reason != FLUSH_NONE && sampleBuffer.encode(reportFrame, report.now)) {
+    uint8_t stats[WIRE_TANK_STATS_LEN];
+    TankAnalytics::toWire(tankStats, stats);
+    reportFrame.putBytes(FIELD_TANK_STATS, stats, sizeof(stats));
+  }
+}
+
+void sendReport() {
+  PendingReport& report = pendingReport;
+  if (report.reason == FLUSH_NONE && !report.telemetryDue) {
+    if (radioExpected) ESP_LOGI(LOG_TAG_MAIN, "Radio started for nothing, no report this cycle");
+    return;
+  }
+  espNowInit();
+  if (reportFrame.hasFields()) {
+    espNow.sendFrame(reportFrame);
+  }
+
+  BootProfiler::begin(PHASE_SEND);
+  bool delivered = espNow.flush(ESPNOW_FLUSH_DEADLINE_MS);
+  if (report.telemetryDue && delivered) {
+    publishBootProfile(); //flushed on its own, its delivery decides whether the statistics restart
+  }
+  BootProfiler::end(PHASE_SEND);
+
+  if (report.reason != FLUSH_NONE && delivered) {
+    sampleBuffer.clear();
+    reportPolicy.commit(report.waterLevel, report.voltageMv, report.charge, report.now);
+    tankAnalytics.alertsDelivered(tankStats.pendingAlerts); //carried by FIELD_TANK_STATS of the report
+  } else if (report.reason != FLUSH_NONE) {
+    reportPolicy.skip();
+    //a long outage would overwrite the RTC ring, flash keeps the samples until the gateway is back
+    BufferedSample samples[SAMPLE_BUFFER_CAPACITY];
+    int count = sampleBuffer.getCount();
+    for (int i = 0; i < count; i++) {
+      samples[i] = sampleBuffer.get(i);
+    }
+    storeUndelivered(samples, count);
+    sampleBuffer.clear();
+  }
+  if (delivered) {
+    backfillStoredSamples();
+    exportLog();
+  }
+}
+
+void readBatteryOrReuse() {
+  if (wakeRoute == WAKE_ROUTE_LEVEL_EDGE && lastBatteryReading.millivolts != 0) {
+    //the level is what woke us, the battery has not moved since the last cycle
+    updateBatteryInfo(lastBatteryReading.charge, lastBatteryReading.millivolts / 1000.0);
+    return;
+  }
+  BootProfiler::begin(PHASE_BATTERY);
+  readBatteryInfo();
+  BootProfiler::end(PHASE_BATTERY);
+}
+
+void configLoadJob(void* context) {
+  loadAppConfig();
+}
+void waterLevelJob(void* context) {
+  BootProfiler::begin(PHASE_WATER_LEVEL);
+  readWaterLevel();
+  BootProfiler::end(PHASE_WATER_LEVEL);
+}
+void batteryJob(void* context) {
+  readBatteryOrReuse();
+}
+void radioInitJob(void* context) {
+  if (radioExpected) espNowInit();
+}
+void encodeJob(void* context) {
+  prepareReport();
+}
+void sendJob(void* context) {
+  sendReport();
+}
+void scheduleJob(void* context) {
+  scheduleNextWakeup();
+}
+
+/**
+ * Runs one LOW_POWER_MODE wake cycle as the job graph of WakeJobs.h. Without WAKE_JOB_GRAPH the same jobs run one after another.
+*/
+void runWakeCycle() {
+  static const JobFunction functions[WAKE_JOB_COUNT] = {
+    configLoadJob, waterLevelJob, batteryJob, radioInitJob, encodeJob, sendJob, scheduleJob
+  };
+  radioExpected = isRadioExpected();
+  JobGraph graph;
+  for (int job = 0; job < WAKE_JOB_COUNT; job++) {
+    bool usesRadio = job == JOB_CONFIG_LOAD || job == JOB_RADIO_INIT || job == JOB_SEND;
+    graph.add(wakeJobNames[job], wakeJobDependencies[job], functions[job], NULL,
+      usesRadio ? WAKE_JOB_RADIO_STACK : JOB_DEFAULT_STACK);
+  }
+  ESP_LOGI(LOG_TAG_MAIN, "Wake cycle jobs start, radio expected: %d", radioExpected);
+  #ifdef WAKE_JOB_GRAPH
+  runJobGraph(graph);
+  #else
+  graph.runSerial();
+  #endif
 }
 
 void setup() {
+  BootProfiler::record(PHASE_STARTUP, (uint32_t)esp_timer_get_time());
   serialInit();
   pinoutInit();
   logInit();
@@ -629,18 +1150,22 @@ void setup() {
   #endif
 
   logBootCount();
-  logWakeupReason();
+  wakeRoute = logWakeupReason();
+  #ifdef WAKE_STUB_FAST_PATH
+  ESP_LOGI(LOG_TAG_MAIN, "Wakes handled by the wake stub since last boot: %d", wakeStubTakeSkippedWakes());
+  #endif
 
+  #ifndef LOW_POWER_MODE
   loadAppConfig();
+  #endif
 
   #ifdef DISPLAY_ENABLED
     changeMenuOption(INSTRUCTIONS);
     button_init();
   #endif
 
-  espNow.init(myConfig.espNowGatewayMacAddress, myConfig.wifiSSID);
-
   #ifndef LOW_POWER_MODE
+  espNowInit();
   #ifdef NTP_TIME_ENABLED
     createTimeTask();
   #endif
@@ -648,8 +1173,7 @@ void setup() {
   createBatteryInfoTask();
   createDeepSleepTask();
   #else
-    waterLevelTask();
-    batteryInfoTask();
+    runWakeCycle();
     initDeepSleep();
   #endif
 }
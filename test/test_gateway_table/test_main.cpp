@@ -0,0 +1,73 @@
+#include <unity.h>
+#include <string.h>
+#include <GatewayTable.h>
+
+static GatewayTableState state;
+static const uint8_t configuredMac[6] = { 0x24, 0x6f, 0x28, 0x00, 0x00, 0x01 };
+static const uint8_t discoveredMac[6] = { 0x24, 0x6f, 0x28, 0x00, 0x00, 0x02 };
+
+void setUp(void) {
+  memset(&state, 0, sizeof(state));
+}
+
+void tearDown(void) {}
+
+static void fail(GatewayTable& table, int index, int cycles) {
+  for (int i = 0; i < cycles; i++) {
+    table.reportResult(index, false);
+  }
+}
+
+void test_failing_discovered_gateway_is_removed(void) {
+  GatewayTable table(&state);
+  table.addConfigured(configuredMac);
+  int discovered = table.addDiscovered(discoveredMac, -60);
+  fail(table, discovered, GATEWAY_TABLE_STALE_FAILURES - 1);
+  TEST_ASSERT_EQUAL(0, table.removeStale());
+  fail(table, discovered, 1);
+  TEST_ASSERT_EQUAL(1, table.removeStale());
+  TEST_ASSERT_EQUAL(1, table.getCount());
+  TEST_ASSERT_EQUAL(-1, table.find(discoveredMac));
+  TEST_ASSERT_EQUAL(0, table.find(configuredMac));
+}
+
+void test_configured_gateway_is_kept_while_listed(void) {
+  GatewayTable table(&state);
+  int configured = table.addConfigured(configuredMac);
+  fail(table, configured, GATEWAY_TABLE_STALE_FAILURES);
+  TEST_ASSERT_EQUAL(0, table.removeStale());
+  //next boot, the gateway was taken out of the configuration
+  GatewayTable rebooted(&state);
+  rebooted.clearConfigured();
+  TEST_ASSERT_EQUAL(1, rebooted.removeStale());
+  TEST_ASSERT_EQUAL(0, rebooted.getCount());
+}
+
+void test_answer_resets_failures(void) {
+  GatewayTable table(&state);
+  int discovered = table.addDiscovered(discoveredMac, -70);
+  fail(table, discovered, GATEWAY_TABLE_STALE_FAILURES - 1);
+  TEST_ASSERT_TRUE(table.allFailing());
+  table.addDiscovered(discoveredMac, -65);
+  TEST_ASSERT_FALSE(table.allFailing());
+  fail(table, discovered, 1);
+  TEST_ASSERT_EQUAL(0, table.removeStale());
+}
+
+void test_best_prefers_delivering_gateway(void) {
+  GatewayTable table(&state);
+  int configured = table.addConfigured(configuredMac);
+  int discovered = table.addDiscovered(discoveredMac, -50);
+  table.reportResult(discovered, true);
+  fail(table, configured, GATEWAY_TABLE_FAILOVER_FAILURES);
+  TEST_ASSERT_EQUAL(discovered, table.best());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_failing_discovered_gateway_is_removed);
+  RUN_TEST(test_configured_gateway_is_kept_while_listed);
+  RUN_TEST(test_answer_resets_failures);
+  RUN_TEST(test_best_prefers_delivering_gateway);
+  return UNITY_END();
+}
@@ -0,0 +1,63 @@
+#include <unity.h>
+#include <LevelLadder.h>
+
+static const uint8_t pins[] = { 25, 26, 27, 13 };
+
+//GPIO snapshot with the given probes wet, probes pull the pin to ground
+static uint64_t snapshot(uint8_t wetMask) {
+  uint64_t gpio = ~0ULL;
+  for (int i = 0; i < 4; i++) {
+    if (wetMask & (1 << i)) gpio &= ~(1ULL << pins[i]);
+  }
+  return gpio;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_no_probes_reads_unknown(void) {
+  LevelLadder ladder(NULL, 0, 0);
+  LadderReading reading = ladder.decode(snapshot(0), true);
+  TEST_ASSERT_EQUAL(LEVEL_PERCENT_UNKNOWN, reading.percent);
+  TEST_ASSERT_FALSE(reading.fault);
+}
+
+void test_contiguous_run_sets_level(void) {
+  LevelLadder ladder(pins, 4, 0);
+  LadderReading reading = ladder.decode(snapshot(0x03), false);
+  TEST_ASSERT_EQUAL(50, reading.percent);
+  TEST_ASSERT_EQUAL_HEX8(0x03, reading.wetMask);
+  TEST_ASSERT_FALSE(reading.fault);
+}
+
+void test_wet_probe_above_dry_one_is_fault(void) {
+  LevelLadder ladder(pins, 4, 0);
+  LadderReading reading = ladder.decode(snapshot(0x05), false);
+  TEST_ASSERT_EQUAL(25, reading.percent);
+  TEST_ASSERT_TRUE(reading.fault);
+}
+
+void test_dry_ladder_under_wet_switch_is_fault(void) {
+  //no probes fitted: the pull-ups read every probe dry
+  LevelLadder ladder(pins, 4, 0, 2);
+  TEST_ASSERT_TRUE(ladder.decode(snapshot(0x00), true).fault);
+  TEST_ASSERT_FALSE(ladder.decode(snapshot(0x00), false).fault);
+}
+
+void test_wet_probe_above_dry_switch_is_fault(void) {
+  LevelLadder ladder(pins, 4, 0, 2);
+  TEST_ASSERT_TRUE(ladder.decode(snapshot(0x07), false).fault);
+  TEST_ASSERT_FALSE(ladder.decode(snapshot(0x03), false).fault);
+  TEST_ASSERT_FALSE(ladder.decode(snapshot(0x07), true).fault);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_no_probes_reads_unknown);
+  RUN_TEST(test_contiguous_run_sets_level);
+  RUN_TEST(test_wet_probe_above_dry_one_is_fault);
+  RUN_TEST(test_dry_ladder_under_wet_switch_is_fault);
+  RUN_TEST(test_wet_probe_above_dry_switch_is_fault);
+  return UNITY_END();
+}
@@ -0,0 +1,130 @@
+#include <unity.h>
+#include <string.h>
+#include <LevelSampler.h>
+
+// Scripted pin: returns the trace one read after the other, repeating the last value
+struct ScriptedPin {
+  const char* trace; //'0' and '1'
+  int position;
+  uint32_t waitedUs;
+};
+
+static ScriptedPin pin;
+static LevelSamplerState state;
+
+static int readPin(void* context) {
+  ScriptedPin* scripted = (ScriptedPin*)context;
+  int length = strlen(scripted->trace);
+  int index = scripted->position < length ? scripted->position : length - 1;
+  scripted->position++;
+  return scripted->trace[index] == '1';
+}
+
+static void waitUs(uint32_t us, void* context) {
+  ((ScriptedPin*)context)->waitedUs += us;
+}
+
+static LevelSampler makeSampler(uint8_t samples, uint8_t hysteresis, uint8_t confirmWakes) {
+  LevelSamplerPlatform platform = { readPin, waitUs, &pin };
+  LevelSamplerConfig config = { samples, 100, hysteresis, confirmWakes };
+  return LevelSampler(&state, platform, config);
+}
+
+static void script(const char* trace) {
+  pin.trace = trace;
+  pin.position = 0;
+}
+
+void setUp(void) {
+  memset(&pin, 0, sizeof(pin));
+  memset(&state, 0, sizeof(state));
+}
+
+void tearDown(void) {}
+
+void test_first_burst_takes_the_majority(void) {
+  LevelSampler sampler = makeSampler(5, 1, 2);
+  script("10110");
+  TEST_ASSERT_EQUAL(1, sampler.update());
+  TEST_ASSERT_EQUAL(3, sampler.getLastHighVotes());
+  TEST_ASSERT_TRUE(state.valid);
+  TEST_ASSERT_EQUAL(4 * 100, pin.waitedUs); //no wait before the first read
+}
+
+void test_hysteresis_holds_the_confirmed_level(void) {
+  LevelSampler sampler = makeSampler(5, 1, 1);
+  script("00000");
+  TEST_ASSERT_EQUAL(0, sampler.update());
+  //3 against 2 is a majority but not enough to leave the confirmed level
+  script("11100");
+  TEST_ASSERT_EQUAL(0, sampler.update());
+  TEST_ASSERT_EQUAL(0, sampler.getLastBurstLevel());
+  script("11110");
+  TEST_ASSERT_EQUAL(1, sampler.update());
+}
+
+void test_change_needs_consecutive_bursts(void) {
+  LevelSampler sampler = makeSampler(3, 0, 3);
+  script("000");
+  sampler.update();
+  script("111");
+  TEST_ASSERT_EQUAL(0, sampler.update());
+  TEST_ASSERT_TRUE(sampler.isPending());
+  script("111");
+  TEST_ASSERT_EQUAL(0, sampler.update());
+  script("111");
+  TEST_ASSERT_EQUAL(1, sampler.update());
+  TEST_ASSERT_FALSE(sampler.isPending());
+}
+
+void test_ripple_resets_the_candidate(void) {
+  LevelSampler sampler = makeSampler(3, 0, 2);
+  script("000");
+  sampler.update();
+  script("111");
+  sampler.update();
+  TEST_ASSERT_TRUE(sampler.isPending());
+  //the surface settles back before the change is confirmed
+  script("000");
+  TEST_ASSERT_EQUAL(0, sampler.update());
+  TEST_ASSERT_FALSE(sampler.isPending());
+  script("111");
+  TEST_ASSERT_EQUAL(0, sampler.update());
+  TEST_ASSERT_TRUE(sampler.isPending());
+}
+
+void test_state_carries_across_wakes(void) {
+  {
+    LevelSampler sampler = makeSampler(3, 0, 2);
+    script("000");
+    sampler.update();
+    script("111");
+    sampler.update();
+  }
+  //deep sleep: a new sampler on the same RTC state finishes the confirmation
+  LevelSampler sampler = makeSampler(3, 0, 2);
+  script("111");
+  TEST_ASSERT_EQUAL(1, sampler.update());
+}
+
+void test_config_is_clamped(void) {
+  LevelSampler sampler = makeSampler(0, 0, 0);
+  script("1");
+  TEST_ASSERT_EQUAL(1, sampler.update());
+  TEST_ASSERT_EQUAL(1, pin.position); //a single read per burst
+  LevelSampler big = makeSampler(200, 0, 1);
+  script("0");
+  big.update();
+  TEST_ASSERT_EQUAL(LEVEL_SAMPLER_MAX_SAMPLES, pin.position);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_burst_takes_the_majority);
+  RUN_TEST(test_hysteresis_holds_the_confirmed_level);
+  RUN_TEST(test_change_needs_consecutive_bursts);
+  RUN_TEST(test_ripple_resets_the_candidate);
+  RUN_TEST(test_state_carries_across_wakes);
+  RUN_TEST(test_config_is_clamped);
+  return UNITY_END();
+}
@@ -0,0 +1,69 @@
+#include <unity.h>
+#include <string.h>
+#include <LogCompression.h>
+
+static uint8_t input[2048];
+static uint8_t packed[4096];
+static uint8_t output[2048];
+
+static void roundTrip(size_t length) {
+  int packedLength = lzCompress(input, length, packed, sizeof(packed));
+  TEST_ASSERT_TRUE(packedLength >= LZ_HEADER_LEN);
+  TEST_ASSERT_EQUAL(length, lzDecompress(packed, packedLength, output, sizeof(output)));
+  TEST_ASSERT_EQUAL(0, memcmp(input, output, length));
+}
+
+void setUp(void) {
+  memset(packed, 0, sizeof(packed));
+}
+
+void tearDown(void) {}
+
+void test_repeated_records_shrink(void) {
+  for (size_t i = 0; i < sizeof(input); i++) {
+    input[i] = (uint8_t)(i % 13 == 0 ? i / 13 : i % 13); //a counter between repeating bytes
+  }
+  roundTrip(sizeof(input));
+  TEST_ASSERT_TRUE(lzCompress(input, sizeof(input), packed, sizeof(packed)) < (int)sizeof(input) / 2);
+}
+
+void test_runs_and_random_bytes_round_trip(void) {
+  uint32_t seed = 1;
+  for (size_t i = 0; i < sizeof(input); i++) {
+    seed = seed * 1103515245 + 12345;
+    input[i] = i < 300 ? 'a' : (uint8_t)(seed >> 16);
+  }
+  roundTrip(sizeof(input));
+  roundTrip(1);
+  roundTrip(0);
+}
+
+void test_output_too_small_is_refused(void) {
+  uint32_t seed = 7;
+  for (size_t i = 0; i < 200; i++) {
+    seed = seed * 1103515245 + 12345;
+    input[i] = (uint8_t)(seed >> 16);
+  }
+  TEST_ASSERT_EQUAL(-1, lzCompress(input, 200, packed, 150));
+}
+
+void test_corrupt_stream_is_rejected(void) {
+  memset(input, 'x', 100);
+  int packedLength = lzCompress(input, 100, packed, sizeof(packed));
+  //cut short
+  TEST_ASSERT_EQUAL(-1, lzDecompress(packed, packedLength - 1, output, sizeof(output)));
+  //longer than the output
+  TEST_ASSERT_EQUAL(-1, lzDecompress(packed, packedLength, output, 99));
+  //match reaching before the start
+  const uint8_t before[] = { 4, 0, 0x00, 0xC0, 0x00 };
+  TEST_ASSERT_EQUAL(-1, lzDecompress(before, sizeof(before), output, sizeof(output)));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_repeated_records_shrink);
+  RUN_TEST(test_runs_and_random_bytes_round_trip);
+  RUN_TEST(test_output_too_small_is_refused);
+  RUN_TEST(test_corrupt_stream_is_rejected);
+  return UNITY_END();
+}
@@ -0,0 +1,169 @@
+#include <unity.h>
+#include <string.h>
+#include <LogExporter.h>
+#include <LogCompression.h>
+
+#define CHUNK_LEN   50 //bytes the fake log hands out per read, one byte per address
+
+static LogExportState state;
+static uint8_t frameBuffer[WIRE_MAX_FRAME_LEN];
+
+static size_t readFakeLog(uint32_t& address, uint32_t limit, uint8_t* out, size_t capacity, void* context) {
+  size_t length = 0;
+  while (address < limit && length < capacity && length < CHUNK_LEN) {
+    out[length++] = (uint8_t)address++;
+  }
+  return length;
+}
+
+static const LogSource source = { &readFakeLog, NULL };
+
+//a log of the same few records over and over, as the tokenized log mostly is
+static size_t readRepeatingLog(uint32_t& address, uint32_t limit, uint8_t* out, size_t capacity, void* context) {
+  size_t length = 0;
+  while (address < limit && length < capacity) {
+    out[length++] = (uint8_t)(address++ % 24);
+  }
+  return length;
+}
+
+//FIELD_LOG_RANGE of the frame
+static void rangeOf(const FrameEncoder& frame, uint32_t& from, uint32_t& to) {
+  FrameDecoder decoder(frame.data(), frame.length());
+  WireField field;
+  while (decoder.nextField(field)) {
+    if (field.tag == FIELD_LOG_RANGE) {
+      from = wireReadU32(field.value);
+      to = wireReadU32(&field.value[4]);
+      return;
+    }
+  }
+  TEST_FAIL_MESSAGE("no FIELD_LOG_RANGE");
+}
+
+//sends up to max frames and returns the first and last address they cover
+static int sendFrames(LogExporter& exporter, int max, uint32_t& from, uint32_t& to) {
+  FrameEncoder frame(frameBuffer, sizeof(frameBuffer));
+  int frames = 0;
+  while (frames < max && exporter.nextFrame(frame)) {
+    uint32_t frameFrom, frameTo;
+    rangeOf(frame, frameFrom, frameTo);
+    if (frames == 0) from = frameFrom;
+    to = frameTo;
+    frames++;
+  }
+  return frames;
+}
+
+void setUp(void) {
+  memset(&state, 0, sizeof(state));
+}
+
+void tearDown(void) {}
+
+void test_failed_flush_sends_the_same_chunks_again(void) {
+  LogExporter exporter(&state, source);
+  exporter.start(0, 200);
+  uint32_t from = 0, to = 0;
+  TEST_ASSERT_EQUAL(2, sendFrames(exporter, 2, from, to));
+  exporter.rewind();
+  TEST_ASSERT_EQUAL(0, exporter.getCursor());
+  TEST_ASSERT_EQUAL(2, sendFrames(exporter, 2, from, to));
+  TEST_ASSERT_EQUAL(0, from);
+  TEST_ASSERT_EQUAL(100, to);
+  exporter.commit();
+  TEST_ASSERT_EQUAL(100, exporter.getCursor());
+  TEST_ASSERT_EQUAL(2, sendFrames(exporter, 4, from, to));
+  TEST_ASSERT_EQUAL(200, to);
+  exporter.commit();
+  TEST_ASSERT_FALSE(exporter.isActive());
+}
+
+void test_gap_request_does_not_restart_the_export(void) {
+  LogExporter exporter(&state, source);
+  exporter.start(0, 300);
+  uint32_t from = 0, to = 0;
+  sendFrames(exporter, 2, from, to);
+  exporter.commit();
+  //the gateway missed part of the first chunk
+  exporter.start(10, 40);
+  TEST_ASSERT_EQUAL(2, exporter.getQueued());
+  TEST_ASSERT_EQUAL(100, exporter.getCursor());
+  TEST_ASSERT_EQUAL(4, sendFrames(exporter, 8, from, to));
+  TEST_ASSERT_EQUAL(100, from);
+  TEST_ASSERT_EQUAL(300, to);
+  exporter.commit();
+  TEST_ASSERT_EQUAL(1, sendFrames(exporter, 8, from, to));
+  TEST_ASSERT_EQUAL(10, from);
+  TEST_ASSERT_EQUAL(40, to);
+  exporter.commit();
+  TEST_ASSERT_FALSE(exporter.isActive());
+}
+
+void test_overlapping_requests_are_merged(void) {
+  LogExporter exporter(&state, source);
+  exporter.start(100, 200);
+  exporter.start(150, 250); //extends the running range
+  exporter.start(10, 40);
+  exporter.start(30, 60);   //joins the queued gap
+  TEST_ASSERT_EQUAL(2, exporter.getQueued());
+  TEST_ASSERT_EQUAL(250, state.ranges[0].end);
+  TEST_ASSERT_EQUAL(10, state.ranges[1].cursor);
+  TEST_ASSERT_EQUAL(60, state.ranges[1].end);
+}
+
+void test_full_queue_widens_the_last_range(void) {
+  LogExporter exporter(&state, source);
+  for (uint32_t i = 0; i < LOG_EXPORT_MAX_RANGES + 1; i++) {
+    exporter.start(1000 - i * 100, 1010 - i * 100);
+  }
+  TEST_ASSERT_EQUAL(LOG_EXPORT_MAX_RANGES, exporter.getQueued());
+  const LogExportRange& last = state.ranges[LOG_EXPORT_MAX_RANGES - 1];
+  TEST_ASSERT_EQUAL(1000 - LOG_EXPORT_MAX_RANGES * 100, last.cursor);
+  TEST_ASSERT_EQUAL(1010 - (LOG_EXPORT_MAX_RANGES - 1) * 100, last.end);
+}
+
+void test_compressed_chunk_carries_more_records(void) {
+  const LogSource repeating = { &readRepeatingLog, NULL };
+  LogExporter exporter(&state, repeating);
+  exporter.start(0, 5000);
+  FrameEncoder frame(frameBuffer, sizeof(frameBuffer));
+  TEST_ASSERT_TRUE(exporter.nextFrame(frame));
+  FrameDecoder decoder(frame.data(), frame.length());
+  TEST_ASSERT_TRUE((decoder.flags() & WIRE_FLAG_COMPRESSED) != 0);
+  uint32_t from, to;
+  rangeOf(frame, from, to);
+  TEST_ASSERT_EQUAL(0, from);
+  TEST_ASSERT_EQUAL(WIRE_LOG_INFLATED_MAX_LEN, to);
+  WireField field;
+  uint8_t inflated[WIRE_LOG_INFLATED_MAX_LEN];
+  int length = -1;
+  while (decoder.nextField(field)) {
+    if (field.tag == FIELD_LOG_RECORDS) length = lzDecompress(field.value, field.length, inflated, sizeof(inflated));
+  }
+  TEST_ASSERT_EQUAL(to - from, length);
+  for (int i = 0; i < length; i++) {
+    TEST_ASSERT_EQUAL(i % 24, inflated[i]);
+  }
+  TEST_ASSERT_TRUE(frame.length() + WIRE_FRAME_SEQUENCE_LEN <= WIRE_MAX_FRAME_LEN);
+}
+
+void test_incompressible_records_go_out_plain(void) {
+  LogExporter exporter(&state, source);
+  exporter.start(0, 40);
+  FrameEncoder frame(frameBuffer, sizeof(frameBuffer));
+  TEST_ASSERT_TRUE(exporter.nextFrame(frame));
+  FrameDecoder decoder(frame.data(), frame.length());
+  TEST_ASSERT_EQUAL(0, decoder.flags() & WIRE_FLAG_COMPRESSED);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_failed_flush_sends_the_same_chunks_again);
+  RUN_TEST(test_gap_request_does_not_restart_the_export);
+  RUN_TEST(test_overlapping_requests_are_merged);
+  RUN_TEST(test_full_queue_widens_the_last_range);
+  RUN_TEST(test_compressed_chunk_carries_more_records);
+  RUN_TEST(test_incompressible_records_go_out_plain);
+  return UNITY_END();
+}
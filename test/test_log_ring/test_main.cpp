@@ -0,0 +1,121 @@
+#include <unity.h>
+#include <string.h>
+#include <thread>
+#include <atomic>
+#include <LogRing.h>
+
+#define PRODUCERS         4
+#define RECORDS_EACH      20000
+
+static LogRing* ring;
+
+//producer u8, sequence u32, then bytes derived from both so a torn copy shows
+static size_t makeRecord(uint8_t* record, uint8_t producer, uint32_t sequence) {
+  size_t length = 5 + (sequence * 7 + producer) % 60;
+  record[0] = producer;
+  memcpy(&record[1], &sequence, 4);
+  for (size_t i = 5; i < length; i++) {
+    record[i] = (uint8_t)(sequence + producer * 31 + i);
+  }
+  return length;
+}
+
+static bool checkRecord(const uint8_t* record, size_t length) {
+  uint32_t sequence;
+  memcpy(&sequence, &record[1], 4);
+  uint8_t expected[LOG_RING_MAX_RECORD];
+  return makeRecord(expected, record[0], sequence) == length && memcmp(expected, record, length) == 0;
+}
+
+void setUp(void) {
+  ring = new LogRing();
+}
+
+void tearDown(void) {
+  delete ring;
+}
+
+void test_records_come_back_in_order_across_the_wrap(void) {
+  uint8_t record[LOG_RING_MAX_RECORD];
+  uint8_t out[LOG_RING_MAX_RECORD];
+  for (uint32_t sequence = 0; sequence < 1000; sequence++) {
+    size_t length = makeRecord(record, 0, sequence);
+    TEST_ASSERT_TRUE(ring->push(record, length));
+    TEST_ASSERT_EQUAL(length, ring->pop(out, sizeof(out)));
+    TEST_ASSERT_EQUAL_MEMORY(record, out, length);
+  }
+  TEST_ASSERT_TRUE(ring->isEmpty());
+}
+
+void test_full_ring_drops_and_counts(void) {
+  uint8_t record[LOG_RING_MAX_RECORD];
+  memset(record, 0xA5, sizeof(record));
+  int pushed = 0;
+  while (ring->push(record, LOG_RING_MAX_RECORD - LOG_RING_HEADER_LEN)) {
+    pushed++;
+  }
+  TEST_ASSERT_EQUAL(4, pushed);
+  TEST_ASSERT_EQUAL(1, ring->getDropped());
+  TEST_ASSERT_FALSE(ring->push(record, 0));
+  TEST_ASSERT_EQUAL(2, ring->getDropped());
+}
+
+void test_concurrent_producers_lose_nothing_uncounted(void) {
+  std::atomic<uint32_t> accepted[PRODUCERS];
+  std::atomic<int> running(PRODUCERS);
+  std::thread producers[PRODUCERS];
+  for (int p = 0; p < PRODUCERS; p++) {
+    accepted[p] = 0;
+    producers[p] = std::thread([p, &accepted, &running]() {
+      uint8_t record[LOG_RING_MAX_RECORD];
+      for (uint32_t sequence = 0; sequence < RECORDS_EACH; sequence++) {
+        size_t length = makeRecord(record, (uint8_t)p, sequence);
+        if (ring->push(record, length)) accepted[p]++;
+      }
+      running--;
+    });
+  }
+
+  uint32_t received[PRODUCERS] = {};
+  int64_t lastSequence[PRODUCERS];
+  for (int p = 0; p < PRODUCERS; p++) lastSequence[p] = -1;
+  bool intact = true;
+  bool ordered = true;
+  uint8_t out[LOG_RING_MAX_RECORD];
+  while (true) {
+    bool done = running.load() == 0;
+    size_t length = ring->pop(out, sizeof(out));
+    if (length == 0) {
+      if (done && ring->isEmpty()) break;
+      std::this_thread::yield();
+      continue;
+    }
+    intact &= length >= 5 && out[0] < PRODUCERS && checkRecord(out, length);
+    if (!intact) break;
+    uint32_t sequence;
+    memcpy(&sequence, &out[1], 4);
+    ordered &= (int64_t)sequence > lastSequence[out[0]];
+    lastSequence[out[0]] = sequence;
+    received[out[0]]++;
+  }
+  for (int p = 0; p < PRODUCERS; p++) {
+    producers[p].join();
+  }
+
+  TEST_ASSERT_TRUE(intact);
+  TEST_ASSERT_TRUE(ordered);
+  uint32_t total = 0;
+  for (int p = 0; p < PRODUCERS; p++) {
+    TEST_ASSERT_EQUAL(accepted[p].load(), received[p]);
+    total += received[p];
+  }
+  TEST_ASSERT_EQUAL(PRODUCERS * RECORDS_EACH, total + ring->getDropped());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_records_come_back_in_order_across_the_wrap);
+  RUN_TEST(test_full_ring_drops_and_counts);
+  RUN_TEST(test_concurrent_producers_lose_nothing_uncounted);
+  return UNITY_END();
+}
@@ -0,0 +1,192 @@
+#include <unity.h>
+#include <string.h>
+#include <LogStore.h>
+#include <MemorySegmentStorage.h>
+
+#define SEGMENT_BYTES   64 //header and four 8 byte records
+#define MAX_SEGMENTS    3
+#define RECORD_LEN      8
+
+static MemorySegments segments;
+static LogStoreState state;
+static const LogStoreConfig config = { SEGMENT_BYTES, MAX_SEGMENTS };
+
+static void appendRecord(LogStore& store, uint8_t value) {
+  uint8_t record[RECORD_LEN];
+  uint8_t framed[LOG_RECORD_FRAME_LEN + RECORD_LEN];
+  memset(record, value, sizeof(record));
+  size_t length = LogStore::frame(framed, record, sizeof(record));
+  TEST_ASSERT_TRUE(store.append(framed, length));
+}
+
+typedef struct {
+  int count;
+  uint8_t values[32];
+} Collected;
+
+static void collect(const uint8_t* record, size_t length, void* context) {
+  Collected* collected = (Collected*)context;
+  TEST_ASSERT_EQUAL(RECORD_LEN, length);
+  collected->values[collected->count++] = record[0];
+}
+
+static void powerLoss() {
+  memset(&state, 0, sizeof(state));
+}
+
+void setUp(void) {
+  segments.clear();
+  powerLoss();
+}
+
+void tearDown(void) {}
+
+void test_records_survive_power_loss(void) {
+  LogStore store(&state, memorySegmentStorage(&segments), config);
+  for (int i = 0; i < 6; i++) {
+    appendRecord(store, i);
+  }
+  powerLoss();
+  appendRecord(store, 6);
+  Collected collected = {};
+  TEST_ASSERT_EQUAL(0, store.forEach(collect, &collected));
+  TEST_ASSERT_EQUAL(7, collected.count);
+  for (int i = 0; i < 7; i++) {
+    TEST_ASSERT_EQUAL(i, collected.values[i]);
+  }
+  TEST_ASSERT_EQUAL(2, segments.size());
+}
+
+void test_torn_record_closes_the_segment(void) {
+  LogStore store(&state, memorySegmentStorage(&segments), config);
+  appendRecord(store, 1);
+  appendRecord(store, 2);
+  //power lost halfway through the second record
+  segments[0].resize(segments[0].size() - 4);
+  powerLoss();
+  appendRecord(store, 3);
+  Collected collected = {};
+  TEST_ASSERT_EQUAL(1, store.forEach(collect, &collected));
+  TEST_ASSERT_EQUAL(2, collected.count);
+  TEST_ASSERT_EQUAL(1, collected.values[0]);
+  TEST_ASSERT_EQUAL(3, collected.values[1]);
+  TEST_ASSERT_EQUAL(2, segments.size()); //nothing appended after the torn tail
+}
+
+void test_corrupt_record_ends_its_segment_only(void) {
+  LogStore store(&state, memorySegmentStorage(&segments), config);
+  for (int i = 0; i < 6; i++) {
+    appendRecord(store, i);
+  }
+  //flip a payload bit of the second record, its CRC no longer matches
+  segments[0][LOG_SEGMENT_HEADER_LEN + LOG_RECORD_FRAME_LEN + RECORD_LEN + LOG_RECORD_FRAME_LEN] ^= 0x01;
+  Collected collected = {};
+  TEST_ASSERT_EQUAL(1, store.forEach(collect, &collected));
+  TEST_ASSERT_EQUAL(3, collected.count);
+  TEST_ASSERT_EQUAL(0, collected.values[0]);
+  TEST_ASSERT_EQUAL(4, collected.values[1]);
+  TEST_ASSERT_EQUAL(5, collected.values[2]);
+}
+
+void test_oldest_segment_is_reused(void) {
+  LogStore store(&state, memorySegmentStorage(&segments), config);
+  for (int i = 0; i < 4 * (MAX_SEGMENTS + 1); i++) {
+    appendRecord(store, i);
+  }
+  TEST_ASSERT_EQUAL(MAX_SEGMENTS, segments.size());
+  TEST_ASSERT_EQUAL(0, segments.count(0));
+  TEST_ASSERT_EQUAL(1 * SEGMENT_BYTES + LOG_SEGMENT_HEADER_LEN, store.getStart());
+  Collected collected = {};
+  store.forEach(collect, &collected);
+  TEST_ASSERT_EQUAL(4 * MAX_SEGMENTS, collected.count);
+  TEST_ASSERT_EQUAL(4, collected.values[0]);
+}
+
+void test_leftover_segment_is_replaced(void) {
+  LogStore store(&state, memorySegmentStorage(&segments), config);
+  appendRecord(store, 1);
+  store.clear();
+  //a segment of an older run with the number the next one gets
+  segments[1].assign(20, 0xEE);
+  appendRecord(store, 2);
+  Collected collected = {};
+  TEST_ASSERT_EQUAL(0, store.forEach(collect, &collected));
+  TEST_ASSERT_EQUAL(1, collected.count);
+  TEST_ASSERT_EQUAL(2, collected.values[0]);
+  TEST_ASSERT_EQUAL(LOG_SEGMENT_HEADER_LEN + LOG_RECORD_FRAME_LEN + RECORD_LEN, segments[1].size());
+}
+
+static int readValues(LogStore& store, uint32_t& address, uint32_t limit, uint8_t* values) {
+  uint8_t out[16 * RECORD_LEN];
+  size_t length = store.read(address, limit, out, sizeof(out));
+  for (size_t i = 0; i < length / RECORD_LEN; i++) {
+    values[i] = out[i * RECORD_LEN];
+  }
+  return length / RECORD_LEN;
+}
+
+void test_read_skips_damaged_records(void) {
+  LogStore store(&state, memorySegmentStorage(&segments), config);
+  for (int i = 0; i < 6; i++) {
+    appendRecord(store, i);
+  }
+  segments[0][LOG_SEGMENT_HEADER_LEN + LOG_RECORD_FRAME_LEN + RECORD_LEN + LOG_RECORD_FRAME_LEN] ^= 0x01;
+  uint32_t address = store.getStart();
+  uint8_t values[16];
+  TEST_ASSERT_EQUAL(3, readValues(store, address, store.getEnd(), values));
+  TEST_ASSERT_EQUAL(0, values[0]);
+  TEST_ASSERT_EQUAL(4, values[1]);
+  TEST_ASSERT_EQUAL(5, values[2]);
+  TEST_ASSERT_EQUAL(store.getEnd(), address);
+}
+
+void test_read_starts_at_oldest_after_recycling(void) {
+  LogStore store(&state, memorySegmentStorage(&segments), config);
+  for (int i = 0; i < 4 * (MAX_SEGMENTS + 1); i++) {
+    appendRecord(store, i);
+  }
+  uint32_t address = LOG_SEGMENT_HEADER_LEN; //first record ever written, recycled since
+  uint8_t values[16];
+  TEST_ASSERT_EQUAL(4 * MAX_SEGMENTS, readValues(store, address, store.getEnd(), values));
+  TEST_ASSERT_EQUAL(4, values[0]);
+}
+
+void test_read_from_inside_a_record_starts_at_the_next(void) {
+  LogStore store(&state, memorySegmentStorage(&segments), config);
+  for (int i = 0; i < 3; i++) {
+    appendRecord(store, i);
+  }
+  uint32_t address = store.getStart() + 2;
+  uint8_t values[16];
+  TEST_ASSERT_EQUAL(2, readValues(store, address, store.getEnd(), values));
+  TEST_ASSERT_EQUAL(1, values[0]);
+}
+
+void test_read_stops_at_limit_and_capacity(void) {
+  LogStore store(&state, memorySegmentStorage(&segments), config);
+  for (int i = 0; i < 6; i++) {
+    appendRecord(store, i);
+  }
+  uint32_t address = store.getStart();
+  uint8_t out[RECORD_LEN * 2];
+  TEST_ASSERT_EQUAL(2 * RECORD_LEN, store.read(address, store.getEnd(), out, sizeof(out)));
+  TEST_ASSERT_EQUAL(1, out[RECORD_LEN]);
+  uint8_t values[16];
+  TEST_ASSERT_EQUAL(2, readValues(store, address, SEGMENT_BYTES + LOG_SEGMENT_HEADER_LEN, values));
+  TEST_ASSERT_EQUAL(2, values[0]);
+  TEST_ASSERT_EQUAL(3, values[1]);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_records_survive_power_loss);
+  RUN_TEST(test_torn_record_closes_the_segment);
+  RUN_TEST(test_corrupt_record_ends_its_segment_only);
+  RUN_TEST(test_oldest_segment_is_reused);
+  RUN_TEST(test_leftover_segment_is_replaced);
+  RUN_TEST(test_read_skips_damaged_records);
+  RUN_TEST(test_read_starts_at_oldest_after_recycling);
+  RUN_TEST(test_read_from_inside_a_record_starts_at_the_next);
+  RUN_TEST(test_read_stops_at_limit_and_capacity);
+  return UNITY_END();
+}
@@ -0,0 +1,71 @@
+#include <unity.h>
+#include <string.h>
+#include <LogTokens.h>
+
+static uint8_t record[LOG_TOKEN_MAX_RECORD_LEN];
+static char text[256];
+
+static size_t encode(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  size_t length = logTokenEncode(record, 1234, format, args);
+  va_end(args);
+  return length;
+}
+
+static const char* render(const char* format, size_t length) {
+  LogTokenRecord parsed;
+  TEST_ASSERT_EQUAL(length, logTokenParse(record, length, parsed));
+  logTokenRender(format, parsed, text, sizeof(text));
+  return text;
+}
+
+void setUp(void) {
+  memset(record, 0, sizeof(record));
+}
+
+void tearDown(void) {}
+
+void test_record_renders_like_printf(void) {
+  const char* format = "level %d, %s at %.1fV, %lld";
+  size_t length = encode(format, -3, "full", 3.7, 5000000000LL);
+  LogTokenRecord parsed;
+  TEST_ASSERT_EQUAL(length, logTokenParse(record, length, parsed));
+  TEST_ASSERT_EQUAL_UINT32(logTokenHash(format), parsed.token);
+  TEST_ASSERT_EQUAL_UINT32(1234, parsed.time);
+  TEST_ASSERT_EQUAL_STRING("level -3, full at 3.7V, 5000000000", render(format, length));
+}
+
+void test_long_string_is_cut(void) {
+  char value[LOG_TOKEN_MAX_STRING + 20];
+  memset(value, 'x', sizeof(value) - 1);
+  value[sizeof(value) - 1] = '\0';
+  size_t length = encode("%s", value);
+  TEST_ASSERT_EQUAL(LOG_TOKEN_MAX_STRING, strlen(render("%s", length)));
+}
+
+void test_oversized_string_length_is_rejected(void) {
+  //length byte above LOG_TOKEN_MAX_STRING that still fits the args
+  const char* format = "name %s, count %d";
+  uint8_t argsLength = 1 + 150 + 4;
+  record[8] = argsLength;
+  record[LOG_TOKEN_HEADER_LEN] = 150;
+  memset(&record[LOG_TOKEN_HEADER_LEN + 1], 'A', 150 + 4);
+  TEST_ASSERT_EQUAL_STRING("name ?, count ?", render(format, LOG_TOKEN_HEADER_LEN + argsLength));
+}
+
+void test_truncated_record_renders_missing_arguments(void) {
+  const char* format = "%d and %d";
+  size_t length = encode(format, 1, 2);
+  record[8] = 4; //second argument lost
+  TEST_ASSERT_EQUAL_STRING("1 and ?", render(format, length - 4));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_record_renders_like_printf);
+  RUN_TEST(test_long_string_is_cut);
+  RUN_TEST(test_oversized_string_length_is_rejected);
+  RUN_TEST(test_truncated_record_renders_missing_arguments);
+  return UNITY_END();
+}
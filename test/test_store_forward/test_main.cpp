@@ -0,0 +1,145 @@
+#include <unity.h>
+#include <string.h>
+#include <StoreForwardQueue.h>
+#include <MemorySegmentStorage.h>
+
+#define SEGMENT_RECORDS  4
+#define MAX_SEGMENTS     3
+
+static MemorySegments segments;
+static StoreForwardState state;
+static const StoreForwardConfig config = { SEGMENT_RECORDS * STORE_FORWARD_RECORD_LEN, MAX_SEGMENTS };
+
+static BufferedSample sampleAt(uint32_t time) {
+  BufferedSample sample = { time, 3, 3700, 80, WIRE_FILL_UNKNOWN, 0 };
+  return sample;
+}
+
+static void pushSamples(StoreForwardQueue& queue, uint32_t from, int count) {
+  for (int i = 0; i < count; i++) {
+    BufferedSample sample = sampleAt(from + i);
+    TEST_ASSERT_EQUAL(1, queue.push(&sample, 1));
+  }
+}
+
+static void powerLoss() {
+  memset(&state, 0, sizeof(state));
+}
+
+void setUp(void) {
+  segments.clear();
+  powerLoss();
+}
+
+void tearDown(void) {}
+
+void test_delivered_samples_are_removed(void) {
+  StoreForwardQueue queue(&state, memorySegmentStorage(&segments), config);
+  pushSamples(queue, 10, 6);
+  TEST_ASSERT_EQUAL(6, queue.getPending());
+  BufferedSample samples[8];
+  QueuePosition end;
+  TEST_ASSERT_EQUAL(6, queue.peek(samples, 8, end));
+  for (int i = 0; i < 6; i++) {
+    TEST_ASSERT_EQUAL(10 + i, samples[i].time);
+    TEST_ASSERT_EQUAL(3700, samples[i].voltageMv);
+  }
+  //peek alone delivers nothing
+  TEST_ASSERT_EQUAL(6, queue.getPending());
+  queue.commit(end);
+  TEST_ASSERT_TRUE(queue.isEmpty());
+  TEST_ASSERT_EQUAL(0, segments.size());
+}
+
+void test_partial_commit_resumes_after_the_last_delivered(void) {
+  StoreForwardQueue queue(&state, memorySegmentStorage(&segments), config);
+  pushSamples(queue, 0, 6);
+  BufferedSample samples[8];
+  QueuePosition end;
+  TEST_ASSERT_EQUAL(5, queue.peek(samples, 5, end));
+  queue.commit(end);
+  TEST_ASSERT_EQUAL(1, queue.getPending());
+  TEST_ASSERT_EQUAL(1, segments.size());
+  TEST_ASSERT_EQUAL(1, queue.peek(samples, 8, end));
+  TEST_ASSERT_EQUAL(5, samples[0].time);
+}
+
+void test_full_queue_drops_the_oldest_segment(void) {
+  StoreForwardQueue queue(&state, memorySegmentStorage(&segments), config);
+  pushSamples(queue, 0, MAX_SEGMENTS * SEGMENT_RECORDS + 2);
+  TEST_ASSERT_EQUAL(SEGMENT_RECORDS, queue.getDropped());
+  TEST_ASSERT_EQUAL((MAX_SEGMENTS - 1) * SEGMENT_RECORDS + 2, queue.getPending());
+  TEST_ASSERT_EQUAL(MAX_SEGMENTS, segments.size());
+  BufferedSample samples[16];
+  QueuePosition end;
+  int count = queue.peek(samples, 16, end);
+  TEST_ASSERT_EQUAL((MAX_SEGMENTS - 1) * SEGMENT_RECORDS + 2, count);
+  for (int i = 0; i < count; i++) {
+    TEST_ASSERT_EQUAL(SEGMENT_RECORDS + i, samples[i].time);
+  }
+}
+
+void test_corrupted_record_is_counted_as_dropped(void) {
+  StoreForwardQueue queue(&state, memorySegmentStorage(&segments), config);
+  pushSamples(queue, 0, 3);
+  segments.begin()->second[STORE_FORWARD_RECORD_LEN + 7] ^= 0x01; //water level of the second record
+  BufferedSample samples[4];
+  QueuePosition end;
+  TEST_ASSERT_EQUAL(2, queue.peek(samples, 4, end));
+  TEST_ASSERT_EQUAL(0, samples[0].time);
+  TEST_ASSERT_EQUAL(2, samples[1].time);
+  queue.commit(end);
+  TEST_ASSERT_TRUE(queue.isEmpty());
+  TEST_ASSERT_EQUAL(1, queue.getDropped());
+}
+
+void test_samples_from_before_a_power_loss_have_unknown_time(void) {
+  StoreForwardQueue queue(&state, memorySegmentStorage(&segments), config);
+  pushSamples(queue, 100, 2);
+  powerLoss();
+  queue.begin();
+  TEST_ASSERT_EQUAL(2, queue.getPending());
+  pushSamples(queue, 5, 1);
+  BufferedSample samples[4];
+  QueuePosition end;
+  TEST_ASSERT_EQUAL(3, queue.peek(samples, 4, end));
+  TEST_ASSERT_EQUAL(SAMPLE_TIME_UNKNOWN, samples[0].time);
+  TEST_ASSERT_EQUAL(SAMPLE_TIME_UNKNOWN, samples[1].time);
+  TEST_ASSERT_EQUAL(5, samples[2].time);
+
+  uint8_t frameBuffer[WIRE_MAX_FRAME_LEN];
+  FrameEncoder frame(frameBuffer, sizeof(frameBuffer));
+  TEST_ASSERT_TRUE(encodeSampleBatch(frame, samples, 3, 65));
+  FrameDecoder decoder(frame.data(), frame.length());
+  WireField field;
+  TEST_ASSERT_TRUE(decoder.nextField(field));
+  TEST_ASSERT_EQUAL(FIELD_SAMPLE_BATCH, field.tag);
+  TEST_ASSERT_EQUAL_UINT32(WIRE_AGE_UNKNOWN, wireReadU32(field.value));
+  TEST_ASSERT_EQUAL_UINT32(WIRE_AGE_UNKNOWN, wireReadU32(&field.value[WIRE_SAMPLE_RECORD_LEN]));
+  TEST_ASSERT_EQUAL_UINT32(60, wireReadU32(&field.value[2 * WIRE_SAMPLE_RECORD_LEN]));
+}
+
+void test_second_power_loss_keeps_older_samples_unknown(void) {
+  StoreForwardQueue queue(&state, memorySegmentStorage(&segments), config);
+  pushSamples(queue, 100, 1);
+  powerLoss();
+  pushSamples(queue, 7, 1);
+  powerLoss();
+  queue.begin();
+  BufferedSample samples[4];
+  QueuePosition end;
+  TEST_ASSERT_EQUAL(2, queue.peek(samples, 4, end));
+  TEST_ASSERT_EQUAL(SAMPLE_TIME_UNKNOWN, samples[0].time);
+  TEST_ASSERT_EQUAL(SAMPLE_TIME_UNKNOWN, samples[1].time);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_delivered_samples_are_removed);
+  RUN_TEST(test_partial_commit_resumes_after_the_last_delivered);
+  RUN_TEST(test_full_queue_drops_the_oldest_segment);
+  RUN_TEST(test_corrupted_record_is_counted_as_dropped);
+  RUN_TEST(test_samples_from_before_a_power_loss_have_unknown_time);
+  RUN_TEST(test_second_power_loss_keeps_older_samples_unknown);
+  return UNITY_END();
+}
@@ -0,0 +1,60 @@
+#include <unity.h>
+#include <string.h>
+#include <TankAnalytics.h>
+
+static TankAnalyticsState state;
+static const TankAnalyticsConfig config = { 6 * 3600, 3.0f, 5.0f, 10 };
+
+void setUp(void) {
+  memset(&state, 0, sizeof(state));
+}
+
+void tearDown(void) {}
+
+void test_switch_flips_are_no_drain(void) {
+  TankAnalytics analytics(&state, config);
+  uint32_t now = 0;
+  for (int i = 0; i < 48; i++, now += 1800) {
+    analytics.update(now, 100, false);
+  }
+  TankStats stats = analytics.update(now, 0, false);
+  TEST_ASSERT_EQUAL(0, stats.rate);
+  TEST_ASSERT_EQUAL(0, stats.anomalyScore);
+  TEST_ASSERT_FALSE(stats.pendingAlerts & TANK_ALERT_FAST_DRAIN);
+  TEST_ASSERT_TRUE(stats.pendingAlerts & TANK_ALERT_LOW_LEVEL);
+}
+
+void test_measured_sudden_drain_alerts(void) {
+  TankAnalytics analytics(&state, config);
+  uint32_t now = 0;
+  for (int i = 0; i < 48; i++, now += 1800) {
+    analytics.update(now, 80, true);
+  }
+  TankStats stats = analytics.update(now, 50, true);
+  TEST_ASSERT_TRUE(stats.pendingAlerts & TANK_ALERT_FAST_DRAIN);
+}
+
+void test_alert_stays_pending_until_delivered(void) {
+  TankAnalytics analytics(&state, config);
+  uint32_t now = 0;
+  for (int i = 0; i < 48; i++, now += 1800) {
+    analytics.update(now, 80, true);
+  }
+  analytics.update(now, 50, true);
+  //the level stopped dropping before the report got through
+  TankStats stats = analytics.update(now + 1800, 50, true);
+  TEST_ASSERT_EQUAL(TANK_ALERT_FAST_DRAIN, stats.pendingAlerts);
+  TEST_ASSERT_EQUAL(TANK_ALERT_FAST_DRAIN, stats.activeAlerts);
+  analytics.alertsDelivered(stats.pendingAlerts);
+  stats = analytics.update(now + 3600, 50, true);
+  TEST_ASSERT_EQUAL(0, stats.pendingAlerts);
+  TEST_ASSERT_EQUAL(0, stats.activeAlerts);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_switch_flips_are_no_drain);
+  RUN_TEST(test_measured_sudden_drain_alerts);
+  RUN_TEST(test_alert_stays_pending_until_delivered);
+  return UNITY_END();
+}
@@ -0,0 +1,145 @@
+#include <unity.h>
+#include <string.h>
+#include <TxPipeline.h>
+
+struct FakeRadio {
+  uint32_t nowMs;
+  int sent;
+  uint8_t lastFrame[TX_PIPELINE_FRAME_LEN];
+};
+
+static FakeRadio radio;
+
+static int fakeSend(const uint8_t* frame, size_t length, void* context) {
+  FakeRadio* fake = (FakeRadio*)context;
+  memcpy(fake->lastFrame, frame, length);
+  fake->sent++;
+  return 0;
+}
+
+static uint32_t fakeNow(void* context) {
+  return ((FakeRadio*)context)->nowMs;
+}
+
+static void fakeSleep(uint32_t ms, void* context) {
+  ((FakeRadio*)context)->nowMs += ms;
+}
+
+static TxPipeline* makePipeline() {
+  TxPlatform platform = { fakeSend, fakeNow, fakeSleep, &radio };
+  TxPipeline* pipeline = new TxPipeline(platform);
+  TxConfig config = { 2, 3, 10, 80, 100 };
+  pipeline->configure(config);
+  return pipeline;
+}
+
+void setUp(void) {
+  memset(&radio, 0, sizeof(radio));
+}
+
+void tearDown(void) {}
+
+void test_confirmations_in_send_order(void) {
+  TxPipeline* pipeline = makePipeline();
+  const uint8_t a[1] = { 'a' };
+  const uint8_t b[1] = { 'b' };
+  TEST_ASSERT_TRUE(pipeline->enqueue(a, 1));
+  TEST_ASSERT_TRUE(pipeline->enqueue(b, 1));
+  TEST_ASSERT_EQUAL(2, pipeline->getInFlightCount());
+  pipeline->onSendComplete(false);
+  pipeline->onSendComplete(true);
+  pipeline->poll();
+  //a failed and is waiting for its backoff, b is delivered
+  TEST_ASSERT_EQUAL(1, pipeline->getCounters().delivered);
+  TEST_ASSERT_EQUAL(1, pipeline->getCounters().retries);
+  radio.nowMs = 10;
+  pipeline->poll();
+  TEST_ASSERT_EQUAL('a', radio.lastFrame[0]);
+  pipeline->onSendComplete(true);
+  TEST_ASSERT_TRUE(pipeline->flush(50));
+  TEST_ASSERT_EQUAL(2, pipeline->getCounters().delivered);
+  delete pipeline;
+}
+
+void test_late_confirmation_is_not_credited_to_the_retry(void) {
+  TxPipeline* pipeline = makePipeline();
+  const uint8_t a[1] = { 'a' };
+  TEST_ASSERT_TRUE(pipeline->enqueue(a, 1));
+  radio.nowMs = 100;
+  pipeline->poll();
+  TEST_ASSERT_EQUAL(1, pipeline->getCounters().timeouts);
+  radio.nowMs = 110;
+  pipeline->poll();
+  TEST_ASSERT_EQUAL(2, radio.sent);
+  //confirmation of the first attempt arrives after its timeout, then the retry fails
+  pipeline->onSendComplete(true);
+  pipeline->onSendComplete(false);
+  pipeline->poll();
+  TEST_ASSERT_EQUAL(1, pipeline->getCounters().late);
+  TEST_ASSERT_EQUAL(0, pipeline->getCounters().delivered);
+  TEST_ASSERT_EQUAL(2, pipeline->getCounters().retries);
+  TEST_ASSERT_FALSE(pipeline->isIdle());
+  delete pipeline;
+}
+
+void test_lost_confirmation_is_forgotten_when_idle(void) {
+  TxPipeline* pipeline = makePipeline();
+  const uint8_t a[1] = { 'a' };
+  TEST_ASSERT_TRUE(pipeline->enqueue(a, 1));
+  //no confirmation ever comes, every attempt times out until the frame is given up
+  TEST_ASSERT_FALSE(pipeline->flush(1000));
+  TEST_ASSERT_EQUAL(1, pipeline->getCounters().failed);
+  TEST_ASSERT_TRUE(pipeline->isIdle());
+  radio.nowMs += 100;
+  pipeline->poll();
+  const uint8_t b[1] = { 'b' };
+  TEST_ASSERT_TRUE(pipeline->enqueue(b, 1));
+  pipeline->onSendComplete(true);
+  pipeline->poll();
+  TEST_ASSERT_EQUAL(1, pipeline->getCounters().delivered);
+  TEST_ASSERT_EQUAL(0, pipeline->getCounters().late);
+  //the failure belonged to the previous batch
+  TEST_ASSERT_TRUE(pipeline->flush(50));
+  delete pipeline;
+}
+
+static int refusingSend(const uint8_t* frame, size_t length, void* context) {
+  ((FakeRadio*)context)->sent++;
+  return -1;
+}
+
+void test_frames_refused_by_the_radio_fail_the_flush(void) {
+  TxPlatform platform = { refusingSend, fakeNow, fakeSleep, &radio };
+  TxPipeline pipeline(platform);
+  TxConfig config = { 2, 3, 10, 80, 100 };
+  pipeline.configure(config);
+  const uint8_t a[1] = { 'a' };
+  TEST_ASSERT_TRUE(pipeline.enqueue(a, 1));
+  TEST_ASSERT_FALSE(pipeline.flush(500));
+  TEST_ASSERT_EQUAL(4, radio.sent);
+  TEST_ASSERT_EQUAL(1, pipeline.getCounters().failed);
+  TEST_ASSERT_FALSE(pipeline.getCounters().deadlineExpired);
+}
+
+void test_frame_dropped_for_lack_of_a_slot_fails_the_flush(void) {
+  TxPipeline* pipeline = makePipeline();
+  uint8_t frame[1] = { 'a' };
+  for (int i = 0; i < TX_PIPELINE_SLOTS; i++) {
+    TEST_ASSERT_NOT_NULL(pipeline->acquire());
+  }
+  TEST_ASSERT_NULL(pipeline->acquire(20));
+  TEST_ASSERT_FALSE(pipeline->enqueue(frame, 1));
+  TEST_ASSERT_EQUAL(2, pipeline->getCounters().rejected);
+  TEST_ASSERT_FALSE(pipeline->flush(10));
+  delete pipeline;
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_confirmations_in_send_order);
+  RUN_TEST(test_late_confirmation_is_not_credited_to_the_retry);
+  RUN_TEST(test_lost_confirmation_is_forgotten_when_idle);
+  RUN_TEST(test_frames_refused_by_the_radio_fail_the_flush);
+  RUN_TEST(test_frame_dropped_for_lack_of_a_slot_fails_the_flush);
+  return UNITY_END();
+}
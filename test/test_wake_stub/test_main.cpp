@@ -0,0 +1,68 @@
+#include <unity.h>
+#include <string.h>
+#include <WakeStub.h>
+
+static WakeStubState state;
+
+void setUp(void) {
+  memset(&state, 0, sizeof(state));
+  state.armed = true;
+  state.expectedLevel = 1;
+  state.remainingSkips = 2;
+}
+
+void tearDown(void) {}
+
+void test_timer_wake_at_expected_level_sleeps(void) {
+  TEST_ASSERT_EQUAL(WAKE_STUB_SLEEP, wakeStubDecide(&state, true, 1));
+  TEST_ASSERT_EQUAL(1, state.remainingSkips);
+  TEST_ASSERT_EQUAL(1, state.skippedWakes);
+  TEST_ASSERT_TRUE(state.armed);
+}
+
+void test_level_past_switch_threshold_boots(void) {
+  TEST_ASSERT_EQUAL(WAKE_STUB_BOOT, wakeStubDecide(&state, true, 0));
+  TEST_ASSERT_FALSE(state.armed);
+  TEST_ASSERT_EQUAL(0, state.skippedWakes);
+  //disarmed, the level going back does not resume skipping
+  TEST_ASSERT_EQUAL(WAKE_STUB_BOOT, wakeStubDecide(&state, true, 1));
+}
+
+void test_skip_budget_runs_out_before_deadline(void) {
+  TEST_ASSERT_EQUAL(WAKE_STUB_SLEEP, wakeStubDecide(&state, true, 1));
+  TEST_ASSERT_EQUAL(WAKE_STUB_SLEEP, wakeStubDecide(&state, true, 1));
+  TEST_ASSERT_EQUAL(WAKE_STUB_BOOT, wakeStubDecide(&state, true, 1));
+  TEST_ASSERT_EQUAL(2, state.skippedWakes);
+  TEST_ASSERT_FALSE(state.armed);
+}
+
+void test_other_wakes_boot(void) {
+  TEST_ASSERT_EQUAL(WAKE_STUB_BOOT, wakeStubDecide(&state, false, 1));
+  state.armed = false;
+  TEST_ASSERT_EQUAL(WAKE_STUB_BOOT, wakeStubDecide(&state, true, 1));
+}
+
+void test_skips_leave_a_boot_before_deadline(void) {
+  //deadline in 3 intervals: two skips, the third wake boots and sends
+  TEST_ASSERT_EQUAL(2, wakeStubSkips(5400, 1800, 5));
+  TEST_ASSERT_EQUAL(1, wakeStubSkips(5399, 1800, 5));
+  TEST_ASSERT_EQUAL(0, wakeStubSkips(1800, 1800, 5));
+  TEST_ASSERT_EQUAL(0, wakeStubSkips(0, 1800, 5));
+}
+
+void test_skips_capped_without_deadline(void) {
+  //empty buffer, no deadline
+  TEST_ASSERT_EQUAL(5, wakeStubSkips(UINT32_MAX, 1800, 5));
+  TEST_ASSERT_EQUAL(0, wakeStubSkips(UINT32_MAX, 0, 5));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_timer_wake_at_expected_level_sleeps);
+  RUN_TEST(test_level_past_switch_threshold_boots);
+  RUN_TEST(test_skip_budget_runs_out_before_deadline);
+  RUN_TEST(test_other_wakes_boot);
+  RUN_TEST(test_skips_leave_a_boot_before_deadline);
+  RUN_TEST(test_skips_capped_without_deadline);
+  return UNITY_END();
+}
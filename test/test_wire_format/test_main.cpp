@@ -0,0 +1,93 @@
+#include <unity.h>
+#include <string.h>
+#include <WireFormat.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_fields_round_trip(void) {
+  uint8_t buffer[WIRE_MAX_FRAME_LEN];
+  FrameEncoder encoder(buffer, sizeof(buffer));
+  encoder.begin(SENSOR_INFO);
+  TEST_ASSERT_FALSE(encoder.hasFields());
+  TEST_ASSERT_TRUE(encoder.putU8(FIELD_WATER_LEVEL, 1));
+  TEST_ASSERT_TRUE(encoder.putU16(FIELD_BATTERY_VOLTAGE, 3712));
+  TEST_ASSERT_TRUE(encoder.putU32(FIELD_TEXT, 0xA1B2C3D4));
+  TEST_ASSERT_EQUAL(WIRE_HEADER_LEN + 3 + 4 + 6, encoder.length());
+
+  FrameDecoder decoder(encoder.data(), encoder.length());
+  TEST_ASSERT_TRUE(decoder.isValid());
+  TEST_ASSERT_EQUAL(SENSOR_INFO, decoder.type());
+  WireField field;
+  TEST_ASSERT_TRUE(decoder.nextField(field));
+  TEST_ASSERT_EQUAL(FIELD_WATER_LEVEL, field.tag);
+  TEST_ASSERT_EQUAL(1, field.asU8());
+  TEST_ASSERT_TRUE(decoder.nextField(field));
+  TEST_ASSERT_EQUAL(3712, field.asU16());
+  TEST_ASSERT_TRUE(decoder.nextField(field));
+  TEST_ASSERT_EQUAL_UINT32(0xA1B2C3D4, field.asU32());
+  TEST_ASSERT_FALSE(decoder.nextField(field));
+  TEST_ASSERT_FALSE(decoder.isMalformed());
+}
+
+void test_unknown_field_is_skipped(void) {
+  uint8_t buffer[WIRE_MAX_FRAME_LEN];
+  FrameEncoder encoder(buffer, sizeof(buffer));
+  encoder.begin(SENSOR_INFO);
+  const uint8_t unknown[3] = { 1, 2, 3 };
+  encoder.putBytes(200, unknown, sizeof(unknown));
+  encoder.putU8(FIELD_BATTERY_CHARGE, 87);
+  FrameDecoder decoder(encoder.data(), encoder.length());
+  WireField field;
+  int charge = -1;
+  while (decoder.nextField(field)) {
+    if (field.tag == FIELD_BATTERY_CHARGE) charge = field.asU8();
+  }
+  TEST_ASSERT_EQUAL(87, charge);
+  TEST_ASSERT_FALSE(decoder.isMalformed());
+}
+
+void test_truncated_field_is_malformed(void) {
+  uint8_t buffer[WIRE_MAX_FRAME_LEN];
+  FrameEncoder encoder(buffer, sizeof(buffer));
+  encoder.begin(SENSOR_INFO);
+  encoder.putU32(FIELD_TEXT, 7);
+  FrameDecoder decoder(encoder.data(), encoder.length() - 1);
+  WireField field;
+  TEST_ASSERT_FALSE(decoder.nextField(field));
+  TEST_ASSERT_TRUE(decoder.isMalformed());
+}
+
+void test_invalid_header(void) {
+  uint8_t frame[WIRE_HEADER_LEN] = { WIRE_MAGIC, WIRE_VERSION + 1, SENSOR_INFO, 0 };
+  TEST_ASSERT_FALSE(FrameDecoder(frame, sizeof(frame)).isValid());
+  frame[1] = WIRE_VERSION;
+  frame[0] = 0;
+  TEST_ASSERT_FALSE(FrameDecoder(frame, sizeof(frame)).isValid());
+  frame[0] = WIRE_MAGIC;
+  TEST_ASSERT_FALSE(FrameDecoder(frame, WIRE_HEADER_LEN - 1).isValid());
+  TEST_ASSERT_TRUE(FrameDecoder(frame, sizeof(frame)).isValid());
+}
+
+void test_encoder_refuses_overflow(void) {
+  uint8_t buffer[WIRE_MAX_FRAME_LEN];
+  uint8_t value[WIRE_MAX_FRAME_LEN] = { 0 };
+  FrameEncoder encoder(buffer, sizeof(buffer));
+  encoder.begin(SENSOR_INFO);
+  size_t capacity = encoder.fieldCapacity();
+  TEST_ASSERT_EQUAL(WIRE_MAX_FRAME_LEN - WIRE_HEADER_LEN - WIRE_FIELD_HEADER_LEN, capacity);
+  TEST_ASSERT_FALSE(encoder.putBytes(FIELD_TEXT, value, capacity + 1));
+  TEST_ASSERT_TRUE(encoder.putBytes(FIELD_TEXT, value, capacity));
+  TEST_ASSERT_FALSE(encoder.putU8(FIELD_WATER_LEVEL, 0));
+  TEST_ASSERT_EQUAL(WIRE_MAX_FRAME_LEN, encoder.length());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_fields_round_trip);
+  RUN_TEST(test_unknown_field_is_skipped);
+  RUN_TEST(test_truncated_field_is_malformed);
+  RUN_TEST(test_invalid_header);
+  RUN_TEST(test_encoder_refuses_overflow);
+  return UNITY_END();
+}
@@ -0,0 +1,240 @@
+#include "GatewayReceiver.h"
+#include <string.h>
+
+GatewayReceiver::GatewayReceiver(GatewayListener* listener, int maxSenders, uint32_t timeoutMs) {
+  this->listener = listener;
+  this->maxSenders = maxSenders;
+  this->timeoutMs = timeoutMs;
+  memset(&stats, 0, sizeof(stats));
+  senders = new Sender[maxSenders];
+  for (int i = 0; i < maxSenders; i++) {
+    senders[i].used = false;
+    senders[i].lastSeenMs = 0;
+  }
+}
+
+GatewayReceiver::~GatewayReceiver() {
+  delete[] senders;
+}
+
+GatewayReceiver::Sender* GatewayReceiver::findSender(const uint8_t* mac, uint32_t nowMs) {
+  Sender* freeSender = NULL;
+  Sender* oldestSender = NULL;
+  for (int i = 0; i < maxSenders; i++) {
+    Sender& sender = senders[i];
+    if (sender.used && memcmp(sender.mac, mac, 6) == 0) return &sender;
+    if (!sender.used) {
+      if (freeSender == NULL) freeSender = &sender;
+    } else if (oldestSender == NULL || (int32_t)(sender.lastSeenMs - oldestSender->lastSeenMs) < 0) {
+      oldestSender = &sender;
+    }
+  }
+  Sender* sender = freeSender;
+  if (sender == NULL) {
+    // every slot is taken, reuse the one of the sender heard from least recently
+    sender = oldestSender;
+  }
+  memcpy(sender->mac, mac, 6);
+  sender->used = true;
+  sender->lastSeenMs = nowMs;
+  sender->sequenceCount = 0;
+  return sender;
+}
+
+void GatewayReceiver::decodeReading(const uint8_t* mac, FrameDecoder& decoder) {
+  SensorReading reading;
+  memset(&reading, 0, sizeof(reading));
+  WireField batch;
+  batch.length = 0;
+  bool hasLiveFields = false;
+  WireField field;
+  while (decoder.nextField(field)) {
+    switch (field.tag) {
+      case FIELD_WATER_LEVEL:
+        reading.hasWaterLevel = true;
+        reading.waterLevel = field.asU8();
+        hasLiveFields = true;
+        break;
+      case FIELD_BATTERY_VOLTAGE:
+        reading.hasBatteryVoltage = true;
+        reading.batteryVoltageMv = field.asU16();
+        hasLiveFields = true;
+        break;
+      case FIELD_BATTERY_CHARGE:
+        reading.hasBatteryCharge = true;
+        reading.batteryCharge = field.asU8();
+        hasLiveFields = true;
+        break;
+      case FIELD_FILL_LEVEL:
+        if (field.length < WIRE_FILL_LEVEL_LEN) break;
+        reading.hasFillLevel = field.value[0] != WIRE_FILL_UNKNOWN;
+        reading.fillPercent = field.value[0];
+        reading.wetProbes = field.value[1];
+        reading.fillFault = (field.value[2] & WIRE_FILL_FLAG_FAULT) != 0;
+        hasLiveFields = true;
+        break;
+      case FIELD_TANK_STATS:
+        if (field.length < WIRE_TANK_STATS_LEN) break;
+        reading.hasTankStats = true;
+        reading.levelAverage = field.value[0];
+        reading.rateAverage = (int16_t)wireReadU16(&field.value[1]);
+        reading.sinceLevelMovedS = wireReadU32(&field.value[3]);
+        reading.anomalyScore = field.value[7];
+        reading.alerts = field.value[8];
+        hasLiveFields = true;
+        break;
+      case FIELD_SAMPLE_BATCH:
+        batch = field;
+        break;
+      default:
+        break; //unknown field, skipped
+    }
+  }
+  if (decoder.isMalformed() || batch.length % WIRE_SAMPLE_RECORD_LEN != 0) {
+    stats.invalid++;
+    return;
+  }
+  for (size_t offset = 0; offset < batch.length; offset += WIRE_SAMPLE_RECORD_LEN) {
+    const uint8_t* record = &batch.value[offset];
+    SensorReading sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.hasWaterLevel = true;
+    sample.waterLevel = record[4];
+    sample.hasBatteryVoltage = true;
+    sample.batteryVoltageMv = wireReadU16(&record[5]);
+    sample.hasBatteryCharge = true;
+    sample.batteryCharge = record[7];
+    sample.hasFillLevel = record[8] != WIRE_FILL_UNKNOWN;
+    sample.fillPercent = record[8];
+    sample.fillFault = (record[9] & WIRE_FILL_FLAG_FAULT) != 0;
+    sample.ageS = wireReadU32(record);
+    stats.readings++;
+    stats.batchedReadings++;
+    listener->onReading(mac, sample);
+  }
+  if (batch.length > 0 && !hasLiveFields) return;
+  stats.readings++;
+  listener->onReading(mac, reading);
+}
+
+void GatewayReceiver::decodeTelemetry(const uint8_t* mac, FrameDecoder& decoder) {
+  PhaseReport phases[GATEWAY_MAX_PHASES];
+  int count = 0;
+  WireField field;
+  while (decoder.nextField(field)) {
+    if (field.tag != FIELD_PHASE_STATS || field.length < WIRE_PHASE_STATS_LEN || count == GATEWAY_MAX_PHASES) continue;
+    PhaseReport& phase = phases[count++];
+    phase.phase = field.value[0];
+    phase.count = wireReadU16(&field.value[1]);
+    phase.minUs = wireReadU32(&field.value[3]);
+    phase.avgUs = wireReadU32(&field.value[7]);
+    phase.maxUs = wireReadU32(&field.value[11]);
+    memcpy(phase.buckets, &field.value[15], WIRE_PHASE_STATS_BUCKETS);
+  }
+  if (decoder.isMalformed()) {
+    stats.invalid++;
+    return;
+  }
+  stats.telemetry++;
+  listener->onTelemetry(mac, phases, count);
+}
+
+void GatewayReceiver::decodeLogChunk(const uint8_t* mac, FrameDecoder& decoder) {
+  WireField range = { 0, 0, NULL };
+  WireField records = { 0, 0, NULL };
+  WireField field;
+  while (decoder.nextField(field)) {
+    if (field.tag == FIELD_LOG_RANGE) range = field;
+    if (field.tag == FIELD_LOG_RECORDS) records = field;
+  }
+  if (decoder.isMalformed() || range.length < WIRE_LOG_RANGE_LEN) {
+    stats.invalid++;
+    return;
+  }
+  if ((decoder.flags() & WIRE_FLAG_COMPRESSED) == 0) {
+    stats.logChunks++;
+    listener->onLogChunk(mac, wireReadU32(range.value), wireReadU32(&range.value[4]), records.value, records.length);
+    return;
+  }
+  uint8_t inflated[WIRE_LOG_INFLATED_MAX_LEN];
+  int length = lzDecompress(records.value, records.length, inflated, sizeof(inflated));
+  if (length < 0) {
+    stats.invalid++;
+    return;
+  }
+  stats.logChunks++;
+  stats.compressedChunks++;
+  stats.compressedBytes += records.length;
+  stats.inflatedBytes += length;
+  listener->onLogChunk(mac, wireReadU32(range.value), wireReadU32(&range.value[4]), inflated, length);
+}
+
+size_t encodeLogRequest(uint8_t* frame, size_t capacity, uint32_t from, uint32_t to) {
+  uint8_t range[WIRE_LOG_RANGE_LEN];
+  wireWriteU32(range, from);
+  wireWriteU32(&range[4], to);
+  FrameEncoder encoder(frame, capacity);
+  encoder.begin(LOG_REQUEST);
+  if (!encoder.putBytes(FIELD_LOG_RANGE, range, sizeof(range))) return 0;
+  return encoder.length();
+}
+
+bool GatewayReceiver::isRetransmission(Sender* sender, FrameDecoder& decoder, uint32_t nowMs) {
+  WireField field;
+  bool found = false;
+  uint16_t sequence = 0;
+  while (decoder.nextField(field)) {
+    if (field.tag == FIELD_FRAME_SEQUENCE && field.length >= 2) {
+      sequence = field.asU16();
+      found = true;
+    }
+  }
+  decoder.rewind();
+  if (!found) return false; //sender too old to stamp its frames
+  // retries come within a fraction of a second, after a longer silence the sensor may have
+  // lost power and started counting again
+  if (nowMs - sender->lastSeenMs >= timeoutMs) sender->sequenceCount = 0;
+  for (int i = 0; i < sender->sequenceCount; i++) {
+    if (sender->sequences[i] == sequence) return true;
+  }
+  if (sender->sequenceCount < GATEWAY_RECENT_SEQUENCES) sender->sequenceCount++;
+  memmove(&sender->sequences[1], &sender->sequences[0], (sender->sequenceCount - 1) * sizeof(sender->sequences[0]));
+  sender->sequences[0] = sequence;
+  return false;
+}
+
+size_t encodeDiscoveryReply(uint8_t* frame, size_t capacity) {
+  FrameEncoder encoder(frame, capacity);
+  encoder.begin(DISCOVERY, WIRE_FLAG_REPLY);
+  return encoder.length();
+}
+
+void GatewayReceiver::onFrame(const uint8_t* mac, const uint8_t* frame, size_t length, uint32_t nowMs) {
+  stats.frames++;
+  FrameDecoder decoder(frame, length);
+  if (!decoder.isValid()) {
+    stats.invalid++;
+    return;
+  }
+
+  Sender* sender = findSender(mac, nowMs);
+  bool repeated = isRetransmission(sender, decoder, nowMs);
+  sender->lastSeenMs = nowMs;
+  if (repeated) {
+    stats.duplicates++;
+    return;
+  }
+  if (decoder.type() == SENSOR_INFO) {
+    decodeReading(mac, decoder);
+  } else if (decoder.type() == TELEMETRY) {
+    decodeTelemetry(mac, decoder);
+  } else if (decoder.type() == LOG_CHUNK) {
+    decodeLogChunk(mac, decoder);
+  } else if (decoder.type() == DISCOVERY) {
+    if ((decoder.flags() & WIRE_FLAG_REPLY) != 0) return; //another gateway answering a sensor
+    stats.discoveries++;
+    listener->onDiscovery(mac);
+  } else {
+    stats.invalid++;
+  }
+}
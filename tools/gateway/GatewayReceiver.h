@@ -0,0 +1,103 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <WireFormat.h>
+#include <LogCompression.h>
+
+#define GATEWAY_DEFAULT_SENDERS       32
+#define GATEWAY_DEFAULT_TIMEOUT_MS    5000  //silence after which a sender may have restarted its frame sequence
+#define GATEWAY_RECENT_SEQUENCES      4     //single frames remembered per sender, more than the sensor has in flight
+
+struct SensorReading {
+  bool hasWaterLevel;
+  uint8_t waterLevel;
+  bool hasBatteryVoltage;
+  uint16_t batteryVoltageMv;
+  bool hasBatteryCharge;
+  uint8_t batteryCharge;
+  bool hasFillLevel;
+  uint8_t fillPercent;
+  uint8_t wetProbes;          //bit 0 = lowest probe, not sent in batches
+  bool fillFault;
+  uint32_t ageS;              //seconds between the reading and the frame, 0 for live readings, WIRE_AGE_UNKNOWN
+                              //when taken before the sensor last lost power
+  bool hasTankStats;
+  uint8_t levelAverage;       //percent
+  int16_t rateAverage;        //0.1 percent per hour, negative when draining
+  uint32_t sinceLevelMovedS;
+  uint8_t anomalyScore;       //tenths of standard deviation
+  uint8_t alerts;             //TANK_ALERT_* of src/TankAnalytics.h
+};
+
+#define GATEWAY_MAX_PHASES            32
+
+struct PhaseReport {
+  uint8_t phase;
+  uint16_t count;
+  uint32_t minUs;
+  uint32_t avgUs;
+  uint32_t maxUs;
+  uint8_t buckets[WIRE_PHASE_STATS_BUCKETS];
+};
+
+struct GatewayStats {
+  uint32_t frames;
+  uint32_t invalid;
+  uint32_t readings;
+  uint32_t batchedReadings;   //part of readings that came in a FIELD_SAMPLE_BATCH
+  uint32_t telemetry;
+  uint32_t discoveries;
+  uint32_t logChunks;
+  uint32_t compressedChunks;  //part of logChunks that came with WIRE_FLAG_COMPRESSED
+  uint32_t compressedBytes;   //bytes received for compressed chunks, compare with inflatedBytes
+  uint32_t inflatedBytes;
+  uint32_t duplicates;
+};
+
+class GatewayListener {
+  public:
+    virtual ~GatewayListener() {};
+    virtual void onReading(const uint8_t* mac, const SensorReading& reading) = 0;
+    virtual void onTelemetry(const uint8_t* mac, const PhaseReport* phases, int count) = 0;
+    virtual void onDiscovery(const uint8_t* mac) = 0; //the gateway should answer with encodeDiscoveryReply to mac
+    // Tokenized records the sensor holds between log addresses from and to, a gap to the previous
+    // chunk can be asked for again with a LOG_REQUEST frame (see encodeLogRequest)
+    virtual void onLogChunk(const uint8_t* mac, uint32_t from, uint32_t to, const uint8_t* records, size_t length) = 0;
+};
+
+// DISCOVERY frame with WIRE_FLAG_REPLY, the answer to a sensor's discovery request.
+// Returns the frame length.
+size_t encodeDiscoveryReply(uint8_t* frame, size_t capacity);
+
+// LOG_REQUEST frame asking a sensor for its log between the addresses from and to,
+// to 0 for everything up to its newest record. Returns the frame length.
+size_t encodeLogRequest(uint8_t* frame, size_t capacity, uint32_t from, uint32_t to);
+
+// Receives raw frames from many sensors at once and decodes each one on arrival.
+// All memory is allocated in the constructor.
+class GatewayReceiver {
+  public:
+    GatewayReceiver(GatewayListener* listener, int maxSenders = GATEWAY_DEFAULT_SENDERS,
+      uint32_t timeoutMs = GATEWAY_DEFAULT_TIMEOUT_MS);
+    ~GatewayReceiver();
+    void onFrame(const uint8_t* mac, const uint8_t* frame, size_t length, uint32_t nowMs);
+    const GatewayStats& getStats() const { return stats; };
+  private:
+    struct Sender {
+      uint8_t mac[6];
+      bool used;
+      uint32_t lastSeenMs;
+      uint8_t sequenceCount;
+      uint16_t sequences[GATEWAY_RECENT_SEQUENCES]; //FIELD_FRAME_SEQUENCE of the latest single frames, newest first
+    };
+    GatewayListener* listener;
+    int maxSenders;
+    uint32_t timeoutMs;
+    Sender* senders;
+    GatewayStats stats;
+    Sender* findSender(const uint8_t* mac, uint32_t nowMs);
+    bool isRetransmission(Sender* sender, FrameDecoder& decoder, uint32_t nowMs);
+    void decodeReading(const uint8_t* mac, FrameDecoder& decoder);
+    void decodeTelemetry(const uint8_t* mac, FrameDecoder& decoder);
+    void decodeLogChunk(const uint8_t* mac, FrameDecoder& decoder);
+};
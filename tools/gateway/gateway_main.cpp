@@ -0,0 +1,277 @@
+// Linux stand-in for the ESP-NOW gateway. Reads raw frames from a UDP socket
+// or from a capture file and prints the decoded readings as Domoticz JSON.
+//
+// UDP datagram:  [sender mac, 6 bytes][frame]
+// Capture file:  repeated [sender mac, 6 bytes][frame length, u16 little-endian][frame]
+//
+// Tokenized logs are printed as text when the firmware ELF is given with --elf.
+// Frame statistics go to stderr at the end of the file, or on Ctrl-C in UDP mode.
+//
+// Log chunks that leave a gap after the previous chunk of the same sensor are asked
+// for again with a LOG_REQUEST frame. With --log-from every sensor is asked for its
+// log from that address on, once, when its first reading arrives. Discovery requests
+// are answered. Requests and answers go back to the UDP sender as [destination mac,
+// 6 bytes][frame]; in file mode they are only printed.
+//
+// Usage: gateway [--elf <firmware.elf>] [--log-from <address>] --udp <port>
+//        gateway [--elf <firmware.elf>] [--log-from <address>] --file <capture>
+
+#include "GatewayReceiver.h"
+#include "../log_decode/LogTokenTable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <map>
+#include <set>
+
+#define DOMOTICZ_VOLTAGE_DEVICE_ID           6
+#define DOMOTICZ_CHARGE_DEVICE_ID            7
+#define DOMOTICZ_WATER_LEVEL_DEVICE_ID       8
+#define DOMOTICZ_FILL_PERCENT_DEVICE_ID      9
+#define MAC_LENGTH                           6
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int) {
+  stopRequested = 1;
+}
+
+static uint32_t nowMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static void formatMac(const uint8_t* mac, char* out) {
+  snprintf(out, 18, "%02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+static uint64_t macKey(const uint8_t* mac) {
+  uint64_t key = 0;
+  for (int i = 0; i < MAC_LENGTH; i++) {
+    key = (key << 8) | mac[i];
+  }
+  return key;
+}
+
+class PrintingListener : public GatewayListener {
+  public:
+    PrintingListener(const LogTokenTable* logTokens, bool requestLog, uint32_t logFrom)
+      : logTokens(logTokens), requestLog(requestLog), logFrom(logFrom) {};
+    void setBridge(int sock, const struct sockaddr_in& address) {
+      bridgeSocket = sock;
+      bridgeAddress = address;
+    }
+    void onReading(const uint8_t* mac, const SensorReading& reading) {
+      char macStr[18];
+      formatMac(mac, macStr);
+      if (requestLog && logRequested.insert(macKey(mac)).second) {
+        sendLogRequest(mac, logFrom, 0);
+      }
+      if (reading.ageS == WIRE_AGE_UNKNOWN) {
+        printf("%s reading from before the sensor lost power, age unknown\n", macStr);
+      } else if (reading.ageS > 0) {
+        printf("%s reading from %u seconds ago\n", macStr, reading.ageS);
+      }
+      if (reading.hasWaterLevel) {
+        printf("%s {\"idx\": %d, \"nvalue\": %d}\n", macStr, DOMOTICZ_WATER_LEVEL_DEVICE_ID, reading.waterLevel);
+      }
+      if (reading.hasBatteryVoltage) {
+        printf("%s {\"idx\": %d, \"nvalue\": 0, \"svalue\": \"%0.2f\"}\n", macStr, DOMOTICZ_VOLTAGE_DEVICE_ID, reading.batteryVoltageMv / 1000.0);
+      }
+      if (reading.hasFillLevel) {
+        printf("%s {\"idx\": %d, \"nvalue\": 0, \"svalue\": \"%d\"}\n", macStr, DOMOTICZ_FILL_PERCENT_DEVICE_ID, reading.fillPercent);
+        if (reading.fillFault) {
+          printf("%s level probe fault, wet probes 0x%02x\n", macStr, reading.wetProbes);
+        }
+      }
+      if (reading.hasTankStats) {
+        printf("%s tank average %d%%, rate %.1f%%/h, level unchanged for %u s, anomaly %.1f, alerts 0x%02x\n", macStr,
+          reading.levelAverage, reading.rateAverage / 10.0, reading.sinceLevelMovedS, reading.anomalyScore / 10.0, reading.alerts);
+      }
+      if (reading.hasBatteryCharge) {
+        printf("%s {\"idx\": %d, \"nvalue\": 0, \"svalue\": \"%d\"}\n", macStr, DOMOTICZ_CHARGE_DEVICE_ID, reading.batteryCharge);
+      }
+      fflush(stdout);
+    }
+    void onTelemetry(const uint8_t* mac, const PhaseReport* phases, int count) {
+      char macStr[18];
+      formatMac(mac, macStr);
+      for (int i = 0; i < count; i++) {
+        const PhaseReport& phase = phases[i];
+        printf("%s phase %d: n=%u min=%uus avg=%uus max=%uus histogram=", macStr, phase.phase, phase.count,
+          phase.minUs, phase.avgUs, phase.maxUs);
+        for (int b = 0; b < WIRE_PHASE_STATS_BUCKETS; b++) {
+          printf(b == 0 ? "%u" : ",%u", phase.buckets[b]);
+        }
+        printf("\n");
+      }
+      fflush(stdout);
+    }
+    void onDiscovery(const uint8_t* mac) {
+      char macStr[18];
+      formatMac(mac, macStr);
+      uint8_t datagram[MAC_LENGTH + WIRE_MAX_FRAME_LEN];
+      memcpy(datagram, mac, MAC_LENGTH);
+      size_t length = encodeDiscoveryReply(&datagram[MAC_LENGTH], WIRE_MAX_FRAME_LEN);
+      if (sendToBridge(datagram, MAC_LENGTH + length)) {
+        printf("%s discovery request answered\n", macStr);
+      } else {
+        printf("%s discovery request not answered, no bridge\n", macStr);
+      }
+      fflush(stdout);
+    }
+    void onLogChunk(const uint8_t* mac, uint32_t from, uint32_t to, const uint8_t* records, size_t length) {
+      char macStr[18];
+      formatMac(mac, macStr);
+      printf("%s log chunk %u to %u, %zu bytes\n", macStr, from, to, length);
+      std::map<uint64_t, uint32_t>::iterator expected = nextLogAddress.find(macKey(mac));
+      if (expected != nextLogAddress.end() && from > expected->second) {
+        printf("%s log chunk %u to %u missing\n", macStr, expected->second, from);
+        sendLogRequest(mac, expected->second, from);
+      }
+      if (expected == nextLogAddress.end() || to > expected->second) {
+        nextLogAddress[macKey(mac)] = to;
+      }
+      if (logTokens != NULL) {
+        char prefix[20];
+        snprintf(prefix, sizeof(prefix), "%s ", macStr);
+        logTokens->print(stdout, prefix, records, length);
+      }
+      fflush(stdout);
+    }
+  private:
+    const LogTokenTable* logTokens;
+    bool requestLog;
+    uint32_t logFrom;
+    std::set<uint64_t> logRequested;
+    std::map<uint64_t, uint32_t> nextLogAddress; //end of the newest log chunk per sensor
+    int bridgeSocket = -1;
+    struct sockaddr_in bridgeAddress;
+    void sendLogRequest(const uint8_t* mac, uint32_t from, uint32_t to) {
+      char macStr[18];
+      formatMac(mac, macStr);
+      uint8_t datagram[MAC_LENGTH + WIRE_MAX_FRAME_LEN];
+      memcpy(datagram, mac, MAC_LENGTH);
+      size_t length = encodeLogRequest(&datagram[MAC_LENGTH], WIRE_MAX_FRAME_LEN, from, to);
+      if (!sendToBridge(datagram, MAC_LENGTH + length)) {
+        printf("%s log request %u to %u not sent, no bridge\n", macStr, from, to);
+        return;
+      }
+      printf("%s log requested from %u to %u\n", macStr, from, to);
+    }
+    bool sendToBridge(const uint8_t* datagram, size_t length) {
+      if (bridgeSocket < 0) return false;
+      sendto(bridgeSocket, datagram, length, 0, (const struct sockaddr*)&bridgeAddress, sizeof(bridgeAddress));
+      return true;
+    }
+};
+
+static void printStats(const GatewayStats& stats) {
+  fprintf(stderr, "frames: %u, invalid: %u, readings: %u (%u batched), telemetry: %u, discoveries: %u, log chunks: %u, duplicates: %u\n",
+    stats.frames, stats.invalid, stats.readings, stats.batchedReadings, stats.telemetry, stats.discoveries, stats.logChunks,
+    stats.duplicates);
+  fprintf(stderr, "compressed log chunks: %u, %u bytes inflated to %u\n",
+    stats.compressedChunks, stats.compressedBytes, stats.inflatedBytes);
+}
+
+static int runUdp(GatewayReceiver& receiver, PrintingListener& listener, int port) {
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0) {
+    perror("socket");
+    return 1;
+  }
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    perror("bind");
+    close(sock);
+    return 1;
+  }
+  struct timeval timeout = { 1, 0 };
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  // the receive timeout also bounds how long a Ctrl-C waits for the statistics
+  signal(SIGINT, requestStop);
+  signal(SIGTERM, requestStop);
+  uint8_t datagram[MAC_LENGTH + WIRE_MAX_FRAME_LEN];
+  while (!stopRequested) {
+    struct sockaddr_in bridge;
+    socklen_t bridgeLength = sizeof(bridge);
+    ssize_t n = recvfrom(sock, datagram, sizeof(datagram), 0, (struct sockaddr*)&bridge, &bridgeLength);
+    if (n > MAC_LENGTH) {
+      listener.setBridge(sock, bridge); //requests go back the way the frames came
+      receiver.onFrame(datagram, &datagram[MAC_LENGTH], n - MAC_LENGTH, nowMs());
+    }
+  }
+  close(sock);
+  return 0;
+}
+
+static int runFile(GatewayReceiver& receiver, const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) {
+    perror(path);
+    return 1;
+  }
+  uint8_t mac[MAC_LENGTH];
+  uint8_t lengthBytes[2];
+  uint8_t frame[WIRE_MAX_FRAME_LEN];
+  uint32_t recordIndex = 0;
+  while (fread(mac, 1, MAC_LENGTH, file) == MAC_LENGTH && fread(lengthBytes, 1, 2, file) == 2) {
+    size_t length = lengthBytes[0] | (lengthBytes[1] << 8);
+    if (length > sizeof(frame) || fread(frame, 1, length, file) != length) {
+      fprintf(stderr, "Truncated or oversized record %u\n", recordIndex);
+      break;
+    }
+    receiver.onFrame(mac, frame, length, recordIndex++); //record index stands in for time
+  }
+  fclose(file);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  LogTokenTable logTokens;
+  bool hasLogTokens = false;
+  bool requestLog = false;
+  uint32_t logFrom = 0;
+  int arg = 1;
+  while (arg + 1 < argc && (strcmp(argv[arg], "--elf") == 0 || strcmp(argv[arg], "--log-from") == 0)) {
+    if (strcmp(argv[arg], "--elf") == 0) {
+      if (!logTokens.load(argv[arg + 1])) {
+        fprintf(stderr, "%s is not a readable 32-bit ELF file\n", argv[arg + 1]);
+        return 1;
+      }
+      hasLogTokens = true;
+    } else {
+      requestLog = true;
+      logFrom = strtoul(argv[arg + 1], NULL, 0);
+    }
+    arg += 2;
+  }
+  if (argc != arg + 2) {
+    fprintf(stderr, "Usage: %s [--elf <firmware.elf>] [--log-from <address>] --udp <port> | --file <capture>\n", argv[0]);
+    return 2;
+  }
+  PrintingListener listener(hasLogTokens ? &logTokens : NULL, requestLog, logFrom);
+  GatewayReceiver receiver(&listener);
+  int result;
+  if (strcmp(argv[arg], "--udp") == 0) {
+    result = runUdp(receiver, listener, atoi(argv[arg + 1]));
+  } else if (strcmp(argv[arg], "--file") == 0) {
+    result = runFile(receiver, argv[arg + 1]);
+  } else {
+    fprintf(stderr, "Unknown option %s\n", argv[arg]);
+    return 2;
+  }
+  printStats(receiver.getStats());
+  return result;
+}
@@ -0,0 +1,73 @@
+// Compares the serial wake cycle with the job graph of src/WakeJobs.h. Each job gets
+// an estimated duration, the graph length is its critical path, i.e. the awake time
+// with every independent job overlapped. The ESP32 has two cores and the Wi-Fi task
+// runs on its own, so the few jobs of a cycle are close to unlimited parallelism.
+//
+// Usage: job_sim [--scan] [--no-report] [--set <job index>=<ms>]...
+
+#include "WakeJobs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//estimated phase durations in ms, from BootProfiler telemetry of the board
+static const uint32_t defaultDurationsMs[WAKE_JOB_COUNT] = {
+  35,   //JOB_CONFIG_LOAD, LittleFS read and JSON parse
+  32,   //JOB_WATER_LEVEL, 15 reads 2 ms apart plus the probe ladder
+  3,    //JOB_BATTERY, 16 averaged ADC reads
+  140,  //JOB_RADIO_INIT, cached channel and ESP-NOW init
+  1,    //JOB_ENCODE
+  25,   //JOB_SEND, flush of the transmit pipeline
+  1     //JOB_SCHEDULE
+};
+#define CHANNEL_SCAN_MS                  2200 //radio init when the cached channel failed
+
+static void usage() {
+  fprintf(stderr, "Usage: job_sim [--scan] [--no-report] [--set <job index>=<ms>]...\n");
+  for (int job = 0; job < WAKE_JOB_COUNT; job++) {
+    fprintf(stderr, "  %d %s\n", job, wakeJobNames[job]);
+  }
+}
+
+int main(int argc, char** argv) {
+  uint32_t durations[WAKE_JOB_COUNT];
+  memcpy(durations, defaultDurationsMs, sizeof(durations));
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--scan") == 0) {
+      durations[JOB_RADIO_INIT] = CHANNEL_SCAN_MS;
+    } else if (strcmp(argv[i], "--no-report") == 0) {
+      durations[JOB_RADIO_INIT] = 0;
+      durations[JOB_SEND] = 0;
+    } else if (strcmp(argv[i], "--set") == 0 && i + 1 < argc) {
+      int job;
+      unsigned ms;
+      if (sscanf(argv[++i], "%d=%u", &job, &ms) != 2 || job < 0 || job >= WAKE_JOB_COUNT) {
+        usage();
+        return 1;
+      }
+      durations[job] = ms;
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  JobGraph graph;
+  for (int job = 0; job < WAKE_JOB_COUNT; job++) {
+    graph.add(wakeJobNames[job], wakeJobDependencies[job], NULL);
+  }
+  uint32_t finish[JOB_GRAPH_MAX_JOBS];
+  uint32_t path;
+  uint32_t length = graph.criticalPath(durations, finish, &path);
+  uint32_t serial = 0;
+
+  printf("%-12s %8s %8s %8s\n", "job", "ms", "start", "finish");
+  for (int job = 0; job < graph.getCount(); job++) {
+    serial += durations[job];
+    printf("%-12s %8u %8u %8u %s\n", graph.get(job).name, (unsigned)durations[job],
+      (unsigned)(finish[job] - durations[job]), (unsigned)finish[job], (path & JOB_BIT(job)) ? "critical" : "");
+  }
+  printf("serial: %u ms, job graph: %u ms, saved: %u ms (%.0f%%)\n", (unsigned)serial, (unsigned)length,
+    (unsigned)(serial - length), serial > 0 ? 100.0 * (serial - length) / serial : 0.0);
+  return 0;
+}
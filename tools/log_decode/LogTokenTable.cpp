@@ -0,0 +1,84 @@
+#include "LogTokenTable.h"
+#include <LogTokens.h>
+#include <elf.h>
+#include <string.h>
+#include <vector>
+
+bool LogTokenTable::load(const char* elfPath) {
+  FILE* file = fopen(elfPath, "rb");
+  if (file == NULL) return false;
+  std::vector<uint8_t> image;
+  uint8_t chunk[65536];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    image.insert(image.end(), chunk, chunk + n);
+  }
+  fclose(file);
+
+  if (image.size() < sizeof(Elf32_Ehdr) || memcmp(image.data(), ELFMAG, SELFMAG) != 0 || image[EI_CLASS] != ELFCLASS32) return false;
+  Elf32_Ehdr header;
+  memcpy(&header, image.data(), sizeof(header));
+  for (int i = 0; i < header.e_shnum; i++) {
+    size_t offset = header.e_shoff + (size_t)i * header.e_shentsize;
+    if (offset + sizeof(Elf32_Shdr) > image.size()) return false;
+    Elf32_Shdr section;
+    memcpy(&section, &image[offset], sizeof(section));
+    //format strings are constants: loaded, not code, with contents in the file
+    if (section.sh_type != SHT_PROGBITS || !(section.sh_flags & SHF_ALLOC) || (section.sh_flags & SHF_EXECINSTR)) continue;
+    if ((size_t)section.sh_offset + section.sh_size > image.size()) continue;
+    addStrings(&image[section.sh_offset], section.sh_size);
+  }
+  return true;
+}
+
+void LogTokenTable::addStrings(const uint8_t* data, size_t length) {
+  size_t start = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (data[i] != '\0') continue;
+    if (i > start) {
+      //any suffix can be a literal of its own, the linker merges strings that end alike
+      std::string text((const char*)&data[start], i - start);
+      for (size_t from = 0; from < text.size(); from++) {
+        const char* format = text.c_str() + from;
+        uint32_t token = logTokenHash(format);
+        std::map<uint32_t, std::string>::iterator found = formats.find(token);
+        if (found == formats.end()) {
+          formats[token] = format;
+        } else if (found->second != format) {
+          collisions++;
+        }
+      }
+    }
+    start = i + 1;
+  }
+}
+
+const char* LogTokenTable::find(uint32_t token) const {
+  std::map<uint32_t, std::string>::const_iterator found = formats.find(token);
+  return found == formats.end() ? NULL : found->second.c_str();
+}
+
+int LogTokenTable::print(FILE* out, const char* prefix, const uint8_t* data, size_t length) const {
+  int count = 0;
+  size_t offset = 0;
+  while (offset < length) {
+    LogTokenRecord record;
+    size_t recordLength = logTokenParse(&data[offset], length - offset, record);
+    if (recordLength == 0) {
+      fprintf(out, "%s%zu bytes of truncated record\n", prefix, length - offset);
+      break;
+    }
+    offset += recordLength;
+    count++;
+    const char* format = find(record.token);
+    if (format == NULL) {
+      fprintf(out, "%s[%u] unknown token 0x%08x, %u argument bytes\n", prefix, record.time, record.token, record.argsLength);
+      continue;
+    }
+    char text[1024];
+    size_t textLength = logTokenRender(format, record, text, sizeof(text));
+    //ESP_LOG formats end with a newline, others may not
+    fprintf(out, "%s[%u] %s%s", prefix, record.time, text, textLength > 0 && text[textLength - 1] == '\n' ? "" : "\n");
+  }
+  return count;
+}
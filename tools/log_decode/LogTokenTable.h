@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <map>
+#include <string>
+
+// Format strings of a firmware build, found by hashing every string constant in the
+// allocated data sections of its ELF file. Decodes the tokenized log records of
+// lib/LogTokens that the same build wrote.
+class LogTokenTable {
+  public:
+    bool load(const char* elfPath); //false when the file is not a 32-bit ELF
+    const char* find(uint32_t token) const; //NULL for an unknown token
+    // Prints one line per record, returns the records printed
+    int print(FILE* out, const char* prefix, const uint8_t* data, size_t length) const;
+    size_t getCount() const { return formats.size(); };
+    size_t getCollisions() const { return collisions; };
+  private:
+    std::map<uint32_t, std::string> formats;
+    size_t collisions = 0;
+    void addStrings(const uint8_t* data, size_t length);
+};
@@ -0,0 +1,54 @@
+// Prints the tokenized log records written by PersistentLog, using the format
+// strings of the firmware ELF that produced them (.pio/build/<env>/firmware.elf).
+// Takes LogStore segment files (the numbered files in /log) or a bare record
+// stream such as the inflated FIELD_LOG_RECORDS of LOG_CHUNK frames.
+//
+// Usage: log_decode <firmware.elf> <log file>...
+
+#include "LogTokenTable.h"
+#include "LogStore.h"
+#include <stdio.h>
+#include <vector>
+
+static void appendRecord(const uint8_t* record, size_t length, void* context) {
+  std::vector<uint8_t>* records = (std::vector<uint8_t>*)context;
+  records->insert(records->end(), record, record + length);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <firmware.elf> <log file>...\n", argv[0]);
+    return 2;
+  }
+  LogTokenTable table;
+  if (!table.load(argv[1])) {
+    fprintf(stderr, "%s is not a readable 32-bit ELF file\n", argv[1]);
+    return 1;
+  }
+  fprintf(stderr, "%zu strings, %zu hash collisions\n", table.getCount(), table.getCollisions());
+  for (int i = 2; i < argc; i++) {
+    FILE* file = fopen(argv[i], "rb");
+    if (file == NULL) {
+      perror(argv[i]);
+      return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+      data.insert(data.end(), chunk, chunk + n);
+    }
+    fclose(file);
+    std::vector<uint8_t> records;
+    int valid = LogStore::parseSegment(data.data(), data.size(), appendRecord, &records);
+    if (valid >= 0) {
+      if (LOG_SEGMENT_HEADER_LEN + (size_t)valid < data.size()) {
+        fprintf(stderr, "%s: %zu bytes after the last valid record skipped\n", argv[i], data.size() - LOG_SEGMENT_HEADER_LEN - valid);
+      }
+      table.print(stdout, "", records.data(), records.size());
+    } else {
+      table.print(stdout, "", data.data(), data.size());
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,262 @@
+// Runs the wake scheduler against synthetic tank and battery traces and compares
+// it with the fixed DEEP_SLEEP_WAKEUP interval, with and without the sensor edge
+// wakeup. The firmware classes are used as is, only the float switch, the clock,
+// the sleep hardware and the energy budget are simulated.
+//
+// Usage: wake_sim [--scenario stable|daily|leak] [--days <n>] [--charge <percent>] [--seed <n>]
+
+#include "WakeScheduler.h"
+#include "LevelSampler.h"
+#include "ReportPolicy.h"
+#include "SampleBuffer.h"
+#include "WakeRouter.h"
+#include "BatteryTable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+//firmware defaults, keep in sync with src/main.cpp and src/Display.h
+#define DEEP_SLEEP_WAKEUP                 1800
+#define WAKE_MIN_INTERVAL                  300
+#define WAKE_MAX_INTERVAL                 7200
+#define WAKE_ACTIVE_CYCLES                   4
+#define WAKE_LOW_CHARGE                     20
+#define WAKE_CRITICAL_CHARGE                10
+#define WATER_LEVEL_SAMPLES                 15
+#define WATER_LEVEL_HYSTERESIS               3
+#define WATER_LEVEL_CONFIRM_WAKES            2
+#define WATER_LEVEL_EDGE_SETTLE_MS        2000
+#define REPORT_VOLTAGE_DEADBAND_MV          50
+#define REPORT_CHARGE_DEADBAND               2
+#define REPORT_HEARTBEAT_CYCLES             12
+#define SAMPLE_BUFFER_THRESHOLD             12
+#define SAMPLE_BUFFER_MAX_LATENCY        21600
+#define SENSOR_WAKE_MAX_PER_WINDOW           6
+#define SENSOR_WAKE_STORM_WINDOW          3600
+#define SENSOR_PIN                          12
+#define BUTTON_RIGHT                        35
+
+//energy model, measured averages of the board
+#define SLEEP_CURRENT_MA                  0.15
+#define WAKE_CURRENT_MA                   40.0
+#define WAKE_DURATION_S                   0.15 //sensor reading only
+#define RADIO_CURRENT_MA                 120.0
+#define RADIO_DURATION_S                  0.60 //ESP-NOW init, send and flush
+#define BATTERY_CAPACITY_MAH            2000.0
+
+#define SWITCH_THRESHOLD                  50.0 //percent of the tank where the float switch flips
+#define SWITCH_RIPPLE                      1.5 //percent around the threshold where reads bounce
+
+enum Scenario { SCENARIO_STABLE, SCENARIO_DAILY, SCENARIO_LEAK };
+
+struct Simulation {
+  Scenario scenario;
+  double timeS;
+  double levelPercent;
+  double usedMah;
+  double startCharge;
+  double wakeAtS;           //armed timer
+  bool pinArmed;
+  uint8_t armedLevel;
+  WakeCause cause;
+};
+
+static double tankLevel(Scenario scenario, double timeS) {
+  double hour = fmod(timeS / 3600.0, 24.0);
+  switch (scenario) {
+    case SCENARIO_STABLE:
+      return 80.0 + 2.0 * sin(timeS / 3600.0);
+    case SCENARIO_DAILY:
+      //used from 7h to 19h, refilled by the pump at night
+      if (hour < 7) return 30.0 + 60.0 * hour / 7.0;
+      if (hour < 19) return 90.0 - 60.0 * (hour - 7) / 12.0;
+      return 30.0;
+    case SCENARIO_LEAK:
+      //stable for two days, then a slow leak empties the tank in a day, refilled next morning
+      if (timeS < 2 * 86400.0) return 85.0;
+      if (timeS < 3 * 86400.0) return 85.0 - 70.0 * (timeS - 2 * 86400.0) / 86400.0;
+      return fmod(timeS, 86400.0 * 3) < 3600 ? 15.0 : 85.0;
+  }
+  return 0;
+}
+
+static int readSwitch(void* context) {
+  Simulation* simulation = (Simulation*)context;
+  double distance = simulation->levelPercent - SWITCH_THRESHOLD;
+  if (fabs(distance) < SWITCH_RIPPLE) {
+    //bouncing, more likely on the side the level is on
+    double high = 0.5 + distance / (2 * SWITCH_RIPPLE);
+    return rand() < high * RAND_MAX ? 1 : 0;
+  }
+  return distance > 0 ? 1 : 0;
+}
+
+static void advance(uint32_t us, void* context) {
+  ((Simulation*)context)->timeS += us / 1e6;
+}
+
+static WakeCause simulatedCause(void* context) {
+  return ((Simulation*)context)->cause;
+}
+
+static void simulatedTimer(uint32_t seconds, void* context) {
+  Simulation* simulation = (Simulation*)context;
+  simulation->wakeAtS = simulation->timeS + seconds;
+}
+
+static void simulatedPinWakeup(uint8_t, uint8_t level, void* context) {
+  Simulation* simulation = (Simulation*)context;
+  simulation->pinArmed = true;
+  simulation->armedLevel = level;
+}
+
+static void simulatedButtonWakeup(uint8_t, uint8_t, void*) {
+  //nobody presses the button in a simulation
+}
+
+static uint32_t simulatedNow(void* context) {
+  return (uint32_t)((Simulation*)context)->timeS;
+}
+
+static uint8_t chargeOf(Simulation& simulation) {
+  double percent = simulation.startCharge - 100.0 * simulation.usedMah / BATTERY_CAPACITY_MAH;
+  return percent < 0 ? 0 : (uint8_t)percent;
+}
+
+static uint16_t millivoltsOf(uint8_t charge) {
+  for (int i = 1; i < BATTERY_TABLE_SIZE; i++) {
+    if (BATTERY_TABLE[i].charge >= charge) return BATTERY_TABLE[i].millivolts;
+  }
+  return BATTERY_TABLE[BATTERY_TABLE_SIZE - 1].millivolts;
+}
+
+struct Result {
+  uint32_t wakes;
+  uint32_t sends;
+  double usedMah;
+  uint8_t endCharge;
+  uint32_t detections;
+  uint32_t missed;
+  double totalLatencyS;
+  double maxLatencyS;
+};
+
+static Result run(const char* name, const WakePolicy& policy, bool edgeWake, Scenario scenario, double days, double startCharge, unsigned seed) {
+  srand(seed);
+  Simulation simulation = { scenario, 0, 0, 0, startCharge, 0, false, 0, WAKE_CAUSE_POWER_ON };
+  WakeRouterState routerState = {};
+  LevelSamplerState samplerState = {};
+  WakeSchedulerState schedulerState = {};
+  ReportState reportState = {};
+  SampleBufferState bufferState = {};
+  LevelSampler sampler(&samplerState, { &readSwitch, &advance, &simulation },
+    { WATER_LEVEL_SAMPLES, 2000, WATER_LEVEL_HYSTERESIS, WATER_LEVEL_CONFIRM_WAKES });
+  WakeScheduler scheduler(&schedulerState, policy);
+  ReportPolicy reportPolicy(&reportState, REPORT_VOLTAGE_DEADBAND_MV, REPORT_CHARGE_DEADBAND, REPORT_HEARTBEAT_CYCLES);
+  SampleBuffer buffer(&bufferState, SAMPLE_BUFFER_THRESHOLD, SAMPLE_BUFFER_MAX_LATENCY);
+  WakeRouter router(&routerState, { &simulatedCause, &simulatedTimer, &simulatedPinWakeup, &simulatedButtonWakeup, &simulatedNow, &simulation },
+    { SENSOR_PIN, BUTTON_RIGHT, 0, (uint8_t)(edgeWake ? SENSOR_WAKE_MAX_PER_WINDOW : 0), SENSOR_WAKE_STORM_WINDOW });
+
+  Result result;
+  memset(&result, 0, sizeof(result));
+  int trueLevel = -1;
+  double changedAtS = -1; //time the true level last moved away from the confirmed one
+  double endS = days * 86400.0;
+  double lastWakeS = 0;
+
+  //the true switch level is tracked every minute to time the changes
+  for (double t = 0; t < endS; t += 60) {
+    int level = tankLevel(scenario, t) > SWITCH_THRESHOLD ? 1 : 0;
+    if (trueLevel >= 0 && level != trueLevel) {
+      if (changedAtS >= 0) result.missed++; //changed back before it was seen
+      changedAtS = changedAtS >= 0 ? -1 : t;
+    }
+    trueLevel = level;
+    simulation.levelPercent = tankLevel(scenario, t);
+    bool timerDue = t >= simulation.wakeAtS;
+    bool edge = !timerDue && simulation.pinArmed && readSwitch(&simulation) == simulation.armedLevel;
+    if (!timerDue && !edge) continue;
+    simulation.cause = timerDue ? (t == 0 ? WAKE_CAUSE_POWER_ON : WAKE_CAUSE_TIMER) : WAKE_CAUSE_SENSOR;
+    simulation.pinArmed = false;
+    simulation.timeS = t;
+    WakeRoute route = router.route();
+
+    double sleptS = t - lastWakeS;
+    simulation.usedMah += SLEEP_CURRENT_MA * sleptS / 3600.0;
+    result.wakes++;
+    simulation.usedMah += WAKE_CURRENT_MA * WAKE_DURATION_S / 3600.0;
+
+    uint8_t previousLevel = sampler.getConfirmedLevel();
+    bool wasValid = samplerState.valid;
+    uint8_t confirmed = sampler.update();
+    //same confirming bursts as readWaterLevel() in src/main.cpp, the chip stays awake while the surface settles
+    for (int i = 1; i < WATER_LEVEL_CONFIRM_WAKES && route == WAKE_ROUTE_LEVEL_EDGE && sampler.isPending(); i++) {
+      simulation.timeS += WATER_LEVEL_EDGE_SETTLE_MS / 1000.0;
+      simulation.usedMah += WAKE_CURRENT_MA * (WATER_LEVEL_EDGE_SETTLE_MS / 1000.0 + WAKE_DURATION_S) / 3600.0;
+      confirmed = sampler.update();
+    }
+    if (wasValid && confirmed != previousLevel && changedAtS >= 0) {
+      double latency = t - changedAtS;
+      result.detections++;
+      result.totalLatencyS += latency;
+      if (latency > result.maxLatencyS) result.maxLatencyS = latency;
+      changedAtS = -1;
+    }
+
+    //same flow as prepareReport() and sendReport() in src/main.cpp, the radio always delivers
+    uint8_t charge = chargeOf(simulation);
+    buffer.push({ (uint32_t)t, confirmed, millivoltsOf(charge), charge, WIRE_FILL_UNKNOWN, 0 });
+    ReportDecision report = reportPolicy.evaluate(confirmed, millivoltsOf(charge), charge);
+    if (buffer.flushReason((uint32_t)t, report.send) != FLUSH_NONE) {
+      result.sends++;
+      simulation.usedMah += RADIO_CURRENT_MA * RADIO_DURATION_S / 3600.0;
+      buffer.clear();
+      reportPolicy.commit(confirmed, millivoltsOf(charge), charge, (uint32_t)t);
+    } else {
+      reportPolicy.skip();
+    }
+
+    WakeDecision decision = scheduler.next(confirmed, sampler.isPending() || route == WAKE_ROUTE_LEVEL_EDGE, charge); //as scheduleNextWakeup()
+    lastWakeS = t;
+    simulation.timeS = t;
+    router.arm(sampler.getLastBurstLevel(), decision.intervalS);
+  }
+  if (changedAtS >= 0) result.missed++;
+  simulation.usedMah += SLEEP_CURRENT_MA * (endS - lastWakeS) / 3600.0;
+  result.usedMah = simulation.usedMah;
+  result.endCharge = chargeOf(simulation);
+
+  printf("%-10s wakes %6u  sends %5u  used %7.1f mAh  end charge %3u%%  detected %3u  missed %3u  latency avg %6.0f s  max %6.0f s\n",
+    name, result.wakes, result.sends, result.usedMah, result.endCharge, result.detections, result.missed,
+    result.detections ? result.totalLatencyS / result.detections : 0.0, result.maxLatencyS);
+  return result;
+}
+
+int main(int argc, char** argv) {
+  Scenario scenario = SCENARIO_DAILY;
+  double days = 30;
+  double charge = 100;
+  unsigned seed = 1;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--scenario") == 0) {
+      scenario = strcmp(argv[i + 1], "stable") == 0 ? SCENARIO_STABLE : strcmp(argv[i + 1], "leak") == 0 ? SCENARIO_LEAK : SCENARIO_DAILY;
+    } else if (strcmp(argv[i], "--days") == 0) {
+      days = atof(argv[i + 1]);
+    } else if (strcmp(argv[i], "--charge") == 0) {
+      charge = atof(argv[i + 1]);
+    } else if (strcmp(argv[i], "--seed") == 0) {
+      seed = (unsigned)atoi(argv[i + 1]);
+    } else {
+      fprintf(stderr, "Usage: %s [--scenario stable|daily|leak] [--days <n>] [--charge <percent>] [--seed <n>]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  WakePolicy fixed = { DEEP_SLEEP_WAKEUP, DEEP_SLEEP_WAKEUP, DEEP_SLEEP_WAKEUP, 0, 0, 0 };
+  WakePolicy adaptive = { WAKE_MIN_INTERVAL, DEEP_SLEEP_WAKEUP, WAKE_MAX_INTERVAL, WAKE_ACTIVE_CYCLES, WAKE_LOW_CHARGE, WAKE_CRITICAL_CHARGE };
+  run("fixed", fixed, false, scenario, days, charge, seed);
+  run("adaptive", adaptive, false, scenario, days, charge, seed);
+  run("edge", adaptive, true, scenario, days, charge, seed);
+  return 0;
+}